@@ -0,0 +1,331 @@
+/* Closed-loop simulation of the HBLED buck converter, for benchmarking control
+modes without the board. The firmware's ADC0_IRQHandler (and so Control_HBLED)
+runs once per PWM period against a discrete-time model of the switch, inductor,
+LED and sense resistor. Update_Set_Current and Control_Outer_Update run every
+1 ms, as Thread_Buck_Update_Setpoint does.
+
+Timing of each PWM period matches the target: the ADC samples the current at
+the start of the period (TPM0 overflow), the ISR writes CnV, and the new duty
+cycle takes effect at the next period. The LED is switched on in the middle
+of the period (center-aligned PWM), so the sample falls at the middle of the
+off time and equals the average current when ripple is triangular.
+
+Usage: buck_sim [-m mode] [-n flashes] [-c peak_mA] [-d on_ms] [-p period_ms]
+	[-N adc_noise_lsb] [-o trace.csv] [-r rec.bin]
+-r saves a control log (Source/recorder.h) of the first flash, for ctl_replay.
+Without -m, every closed-loop mode is simulated in a separate process, so
+static controller state from one mode doesn't leak into the next. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <MKL25Z4.h>
+
+#include "control.h"
+#include "recorder.h"
+
+// Plant model. Defaults approximate the HBLED shield; override with -D.
+#ifndef SIM_V_IN
+#define SIM_V_IN (5.0) // V
+#endif
+#ifndef SIM_L
+#define SIM_L (2.2e-3) // H
+#endif
+#ifndef SIM_LED_VF
+#define SIM_LED_VF (2.7) // V, LED threshold voltage
+#endif
+#ifndef SIM_LED_RD
+#define SIM_LED_RD (1.0) // ohm, LED dynamic resistance
+#endif
+#ifndef SIM_R_PARASITIC
+#define SIM_R_PARASITIC (0.5) // ohm, inductor and switch
+#endif
+#ifndef SIM_DIODE_VF
+#define SIM_DIODE_VF (0.35) // V, freewheeling diode
+#endif
+
+#define SIM_PWM_FREQ_HZ (48000000.0/(2*PWM_PERIOD))
+#define SIM_T_PWM (1.0/SIM_PWM_FREQ_HZ)
+#define SIM_PERIODS_PER_MS ((int)(SIM_PWM_FREQ_HZ/1000 + 0.5))
+#define SIM_SETTLE_BAND_PCT (5) // Settled when within this band of setpoint...
+#define SIM_SETTLE_BAND_MIN_MA (1.0) // ...but never narrower than this
+
+// Functions in control.c without prototypes in control.h
+void ADC0_IRQHandler(void);
+
+typedef struct {
+	int Pulses, Risen_Pulses, Settled_Pulses;
+	double Rise_Sum, Overshoot_Sum, Settle_Sum; // us, %, us
+	double Err_Sq_Sum; // mA^2, over all periods with LED on
+	int Err_Count;
+} SIM_METRICS_T;
+
+typedef struct { // Per-pulse tracking
+	int Active;
+	int N; // periods since setpoint step
+	double Set, Peak;
+	int N10, N90, N_Last_Out; // -1 until reached
+} SIM_PULSE_T;
+
+static const char * Mode_Names[] = {"OpenLoop", "BangBang", "Incremental",
+	"Proportional", "PID", "PID_FX", "PID_FX_Split"};
+#define SIM_NUM_MODES (sizeof(Mode_Names)/sizeof(Mode_Names[0]))
+
+static int num_flashes = 3, adc_noise_lsb = 0;
+static const char * trace_name = NULL, * rec_name = NULL;
+
+/* Advance inductor current i (A) by dt with drive voltage v across the series
+resistance. Current can't reverse because of the LED and diode. Adds integral
+of current over dt to *area. */
+static double Plant_Segment(double i, double v, double dt, double * area) {
+	double r = SIM_LED_RD + R_SENSE + SIM_R_PARASITIC;
+	double tau = SIM_L/r;
+	double i_inf = v/r;
+	double t0;
+
+	if (i_inf < 0) {
+		if (i <= 0)
+			return 0;
+		t0 = tau*log((i - i_inf)/(-i_inf)); // time to reach zero
+		if (t0 < dt) {
+			*area += i_inf*t0 + (i - i_inf)*tau*(1 - exp(-t0/tau));
+			return 0;
+		}
+	}
+	*area += i_inf*dt + (i - i_inf)*tau*(1 - exp(-dt/tau));
+	return i_inf + (i - i_inf)*exp(-dt/tau);
+}
+
+/* Simulate one PWM period with on-time fraction d. Returns average current. */
+static double Plant_Period(double * i, double d) {
+	double area = 0;
+	double v_on = SIM_V_IN - SIM_LED_VF;
+	double v_off = -SIM_LED_VF - SIM_DIODE_VF;
+	double t_off = (1 - d)*SIM_T_PWM/2;
+
+	*i = Plant_Segment(*i, v_off, t_off, &area);
+	*i = Plant_Segment(*i, v_on, d*SIM_T_PWM, &area);
+	*i = Plant_Segment(*i, v_off, t_off, &area);
+	return area/SIM_T_PWM;
+}
+
+/* 16-bit ADC reading of sense resistor voltage, with optional uniform noise. */
+static uint16_t ADC_Convert(double i) {
+	static uint32_t seed = 12345;
+	double code = i*R_SENSE/V_REF*ADC_FULL_SCALE;
+
+	if (adc_noise_lsb > 0) {
+		seed = seed*1664525 + 1013904223;
+		code += (int)(seed >> 16) % (2*adc_noise_lsb + 1) - adc_noise_lsb;
+	}
+	if (code < 0)
+		code = 0;
+	else if (code > ADC_FULL_SCALE-1)
+		code = ADC_FULL_SCALE-1;
+	return (uint16_t) code;
+}
+
+static void Pulse_Finish(SIM_PULSE_T * p, SIM_METRICS_T * m) {
+	m->Pulses++;
+	if ((p->N10 >= 0) && (p->N90 >= 0)) {
+		m->Risen_Pulses++;
+		m->Rise_Sum += (p->N90 - p->N10)*SIM_T_PWM*1e6;
+	}
+	m->Overshoot_Sum += (p->Peak > p->Set)? (p->Peak - p->Set)*100/p->Set : 0;
+	if (p->N_Last_Out < p->N - 1) {
+		m->Settled_Pulses++;
+		m->Settle_Sum += (p->N_Last_Out + 1)*SIM_T_PWM*1e6;
+	}
+}
+
+/* Track step response metrics for the period just simulated. */
+static void Pulse_Update(SIM_PULSE_T * p, SIM_METRICS_T * m, double set, double i_avg) {
+	double band;
+
+	if (set > 0) {
+		if (!p->Active || (set != p->Set)) { // New step
+			if (p->Active)
+				Pulse_Finish(p, m);
+			p->Active = 1;
+			p->N = 0;
+			p->Set = set;
+			p->Peak = 0;
+			p->N10 = p->N90 = p->N_Last_Out = -1;
+		}
+		if ((p->N10 < 0) && (i_avg >= 0.1*set))
+			p->N10 = p->N;
+		if ((p->N90 < 0) && (i_avg >= 0.9*set))
+			p->N90 = p->N;
+		if (i_avg > p->Peak)
+			p->Peak = i_avg;
+		band = set*SIM_SETTLE_BAND_PCT/100;
+		if (band < SIM_SETTLE_BAND_MIN_MA)
+			band = SIM_SETTLE_BAND_MIN_MA;
+		if (fabs(i_avg - set) > band)
+			p->N_Last_Out = p->N;
+		m->Err_Sq_Sum += (i_avg - set)*(i_avg - set);
+		m->Err_Count++;
+		p->N++;
+	} else if (p->Active) {
+		Pulse_Finish(p, m);
+		p->Active = 0;
+	}
+}
+
+static void Save_Rec_Log(const char * name) {
+	FILE * f = fopen(name, "wb");
+
+	if (f == NULL) {
+		perror(name);
+		exit(1);
+	}
+	fwrite(&g_rec_log, 1, sizeof(REC_HEADER_T) + 4*g_rec_log.Header.NumWords, f);
+	fclose(f);
+}
+
+static void Run_Mode(CTL_MODE_E mode) {
+	SIM_METRICS_T m;
+	SIM_PULSE_T p;
+	FILE * trace = NULL;
+	double i = 0, i_avg, set;
+	long n, num_periods;
+	int faults = 0, cnv, cnv_active = 0;
+
+	memset(&m, 0, sizeof(m));
+	memset(&p, 0, sizeof(p));
+	if (trace_name != NULL) {
+		trace = fopen(trace_name, "w");
+		if (trace == NULL) {
+			perror(trace_name);
+			exit(1);
+		}
+		fprintf(trace, "t_us,set_mA,measured_mA,avg_mA,duty\n");
+	}
+
+	control_mode = mode;
+	Init_Buck_HBLED();
+	if (rec_name != NULL)
+		Rec_Arm();
+	num_periods = (long) num_flashes*g_flash_period*SIM_PERIODS_PER_MS;
+
+	for (n = 0; n < num_periods; n++) {
+		if (n % SIM_PERIODS_PER_MS == 0) { // Thread_Buck_Update_Setpoint
+			Update_Set_Current();
+			Control_Outer_Update();
+		}
+
+		// TPM0 overflow triggers conversion, ISR updates CnV for next period
+		ADC0->R[0] = ADC_Convert(i);
+		set = g_set_current;
+		ADC0_IRQHandler();
+		if (g_led_fault && !faults) {
+			faults = g_led_fault;
+			printf("%-13s fault 0x%x at %.1f ms\n", Mode_Names[mode], faults, n*SIM_T_PWM*1e3);
+		}
+
+		// CnV written now is loaded at the next overflow. Pin handed to GPIO 
+		// turns switch off immediately.
+		if ((PORTE->PCR[PWM_HBLED_PIN] & PORT_PCR_MUX_MASK) != PORT_PCR_MUX(3))
+			cnv = 0;
+		else
+			cnv = cnv_active;
+		cnv_active = TPM0->CONTROLS[PWM_HBLED_CHANNEL].CnV;
+
+		i_avg = Plant_Period(&i, (double) cnv/PWM_PERIOD)*1000; // mA
+		Pulse_Update(&p, &m, set, i_avg);
+		if (trace != NULL)
+			fprintf(trace, "%.1f,%.0f,%d,%.3f,%d\n", n*SIM_T_PWM*1e6, set, g_measured_current, i_avg, cnv);
+	}
+	if (p.Active)
+		Pulse_Finish(&p, &m);
+	if (trace != NULL)
+		fclose(trace);
+	if (rec_name != NULL)
+		Save_Rec_Log(rec_name);
+
+	printf("%-13s %6d", Mode_Names[mode], m.Pulses);
+	if (m.Risen_Pulses > 0)
+		printf(" %9.1f", m.Rise_Sum/m.Risen_Pulses);
+	else
+		printf(" %9s", "-");
+	if (m.Pulses > 0)
+		printf(" %9.1f", m.Overshoot_Sum/m.Pulses);
+	else
+		printf(" %9s", "-");
+	if (m.Settled_Pulses > 0)
+		printf(" %9.1f %3d/%-3d", m.Settle_Sum/m.Settled_Pulses, m.Settled_Pulses, m.Pulses);
+	else
+		printf(" %9s %3d/%-3d", "-", 0, m.Pulses);
+	printf(" %8.3f\n", m.Err_Count? sqrt(m.Err_Sq_Sum/m.Err_Count) : 0.0);
+}
+
+static int Parse_Mode(const char * s) {
+	unsigned int i;
+	for (i = 0; i < SIM_NUM_MODES; i++) {
+		if (strcmp(s, Mode_Names[i]) == 0)
+			return i;
+	}
+	return -1;
+}
+
+int main(int argc, char * argv[]) {
+	int opt, mode = -1;
+	unsigned int i;
+	pid_t pid;
+
+	while ((opt = getopt(argc, argv, "m:n:c:d:p:N:o:r:")) != -1) {
+		switch (opt) {
+			case 'm':
+				mode = Parse_Mode(optarg);
+				if (mode < 0) {
+					fprintf(stderr, "Unknown mode %s\n", optarg);
+					return 1;
+				}
+				break;
+			case 'n': num_flashes = atoi(optarg); break;
+			case 'c': g_peak_set_current = atoi(optarg); break;
+			case 'd': g_flash_duration = atoi(optarg); break;
+			case 'p': g_flash_period = atoi(optarg); break;
+			case 'N': adc_noise_lsb = atoi(optarg); break;
+			case 'o': trace_name = optarg; break;
+			case 'r': rec_name = optarg; break;
+			default:
+				fprintf(stderr, "Usage: %s [-m mode] [-n flashes] [-c peak_mA] [-d on_ms] [-p period_ms] [-N adc_noise_lsb] [-o trace.csv] [-r rec.bin]\n", argv[0]);
+				return 1;
+		}
+	}
+	if ((g_flash_duration <= 0) || (g_flash_period <= g_flash_duration) || (num_flashes <= 0)) {
+		fprintf(stderr, "Need 0 < on time < period and at least one flash\n");
+		return 1;
+	}
+
+	printf("%d flashes of %d mA for %d ms every %d ms, PWM %.0f Hz, ADC noise %d LSB\n",
+		num_flashes, g_peak_set_current, g_flash_duration, g_flash_period, SIM_PWM_FREQ_HZ, adc_noise_lsb);
+	printf("%-13s %6s %9s %9s %9s %7s %8s\n", "mode", "pulses", "rise_us", "ovsht_%", "settle_us", "settled", "rms_mA");
+	if (mode >= 0) {
+		Run_Mode(mode);
+		return 0;
+	}
+	if ((trace_name != NULL) || (rec_name != NULL)) {
+		fprintf(stderr, "-o and -r need -m\n");
+		return 1;
+	}
+	for (i = BangBang; i < SIM_NUM_MODES; i++) {
+		fflush(stdout);
+		pid = fork();
+		if (pid == 0) {
+			Run_Mode(i);
+			fflush(stdout);
+			_exit(0);
+		} else if (pid > 0) {
+			waitpid(pid, NULL, 0);
+		} else {
+			perror("fork");
+			return 1;
+		}
+	}
+	return 0;
+}
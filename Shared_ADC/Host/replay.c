@@ -0,0 +1,218 @@
+/* Replay a control loop log (see Source/recorder.h) through the natively
+compiled Control_HBLED and compare the PWM compare values it produces with
+those recorded on the target. Any difference means the controller code or
+configuration no longer behaves like the recorded firmware.
+
+Usage: ctl_replay [-o out.csv] [-v] log.{bin|hex}
+The log may be a raw binary image of g_rec_log or Intel HEX as written by the
+uVision SAVE command. Exit status is 0 only if the replay is bit-exact. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <MKL25Z4.h>
+
+#include "control.h"
+#include "recorder.h"
+#include "timers.h"
+
+#define MAX_SHOWN_MISMATCHES (10)
+
+static REC_LOG_T rec_log;
+
+static int Hex_Byte(const char * s) {
+	unsigned int b;
+	if (sscanf(s, "%2x", &b) != 1)
+		return -1;
+	return b;
+}
+
+/* Read Intel HEX into buf, placing the lowest address at buf[0]. Returns bytes used. */
+static long Load_Hex(FILE * f, uint8_t * buf, long size) {
+	char line[600];
+	uint32_t base = 0, addr, start = 0;
+	int have_start = 0, len, type, i, b;
+	long used = 0;
+
+	while (fgets(line, sizeof(line), f) != NULL) {
+		if (line[0] != ':')
+			continue;
+		len = Hex_Byte(line+1);
+		addr = (Hex_Byte(line+3) << 8) | Hex_Byte(line+5);
+		type = Hex_Byte(line+7);
+		if ((len < 0) || (type < 0) || ((int) strlen(line) < 11 + 2*len))
+			return -1;
+		if (type == 1) { // end of file
+			break;
+		} else if (type == 4) { // extended linear address
+			base = ((uint32_t) Hex_Byte(line+9) << 24) | ((uint32_t) Hex_Byte(line+11) << 16);
+		} else if (type == 0) {
+			addr += base;
+			if (!have_start) {
+				start = addr;
+				have_start = 1;
+			}
+			for (i = 0; i < len; i++) {
+				b = Hex_Byte(line + 9 + 2*i);
+				if ((b < 0) || (addr + i < start))
+					return -1;
+				if (addr + i - start < (uint32_t) size) {
+					buf[addr + i - start] = b;
+					if (addr + i - start + 1 > used)
+						used = addr + i - start + 1;
+				}
+			}
+		}
+	}
+	return used;
+}
+
+static int Load_Log(const char * name) {
+	FILE * f;
+	int c;
+	long n;
+
+	f = fopen(name, "rb");
+	if (f == NULL) {
+		perror(name);
+		return 0;
+	}
+	c = fgetc(f);
+	rewind(f);
+	if (c == ':')
+		n = Load_Hex(f, (uint8_t *) &rec_log, sizeof(rec_log));
+	else
+		n = fread(&rec_log, 1, sizeof(rec_log), f);
+	fclose(f);
+
+	if (n < (long) sizeof(REC_HEADER_T)) {
+		fprintf(stderr, "%s: too short or unreadable\n", name);
+		return 0;
+	}
+	if ((rec_log.Header.Magic != REC_MAGIC) || (rec_log.Header.Version != REC_VERSION)) {
+		fprintf(stderr, "%s: not a version %d control log\n", name, REC_VERSION);
+		return 0;
+	}
+	if (rec_log.Header.NumWords > REC_LOG_WORDS)
+		rec_log.Header.NumWords = REC_LOG_WORDS;
+	if (n < (long)(sizeof(REC_HEADER_T) + 4*rec_log.Header.NumWords)) {
+		fprintf(stderr, "%s: log truncated\n", name);
+		rec_log.Header.NumWords = (n - sizeof(REC_HEADER_T))/4;
+	}
+	return 1;
+}
+
+static void Apply_Event(uint32_t type, uint32_t * payload) {
+	switch (type) {
+		case REC_EV_SET_CURRENT:
+			g_set_current = payload[0];
+			break;
+		case REC_EV_ENABLE:
+			g_enable_control = payload[0];
+			break;
+		case REC_EV_MODE:
+			control_mode = (CTL_MODE_E) payload[0];
+			break;
+		case REC_EV_INNER_PARAMS:
+			ctl_inner_params[ctl_inner_idx].DutyFF = payload[0];
+			ctl_inner_params[ctl_inner_idx].PGain = payload[1];
+			break;
+		case REC_EV_PGAIN_8:
+			pGain_8 = payload[0];
+			break;
+		case REC_EV_PID_GAINS:
+			memcpy(&plantPID.pGain, &payload[0], sizeof(float));
+			memcpy(&plantPID.iGain, &payload[1], sizeof(float));
+			memcpy(&plantPID.dGain, &payload[2], sizeof(float));
+			break;
+		case REC_EV_PID_FX_GAINS:
+			plantPID_FX.pGain = payload[0];
+			plantPID_FX.iGain = payload[1];
+			plantPID_FX.dGain = payload[2];
+			break;
+		case REC_EV_DUTY_CYCLE:
+			g_duty_cycle = payload[0];
+			PWM_Set_Value(TPM0, PWM_HBLED_CHANNEL, g_duty_cycle);
+			break;
+		case REC_EV_FAULT_CLEAR:
+			Control_Fault_Clear();
+			break;
+		default:
+			fprintf(stderr, "Unknown event type %u ignored\n", type);
+			break;
+	}
+}
+
+int main(int argc, char * argv[]) {
+	FILE * out = NULL;
+	uint32_t k, w, len, cnv, num_samples = 0, mismatches = 0;
+	int opt, verbose = 0;
+	struct timespec t0, t1;
+	double ns = 0;
+
+	while ((opt = getopt(argc, argv, "o:v")) != -1) {
+		switch (opt) {
+			case 'o':
+				out = fopen(optarg, "w");
+				if (out == NULL) {
+					perror(optarg);
+					return 2;
+				}
+				fprintf(out, "sample,adc,recorded,replayed\n");
+				break;
+			case 'v': verbose = 1; break;
+			default:
+				fprintf(stderr, "Usage: %s [-o out.csv] [-v] log.{bin|hex}\n", argv[0]);
+				return 2;
+		}
+	}
+	if ((optind >= argc) || !Load_Log(argv[optind]))
+		return 2;
+	if (rec_log.Header.Config != REC_CONFIG) {
+		fprintf(stderr, "Recorded with PWM_PERIOD %u, dither %u order %u but built with %u, %u, %u\n",
+			rec_log.Header.Config & 0xffff, (rec_log.Header.Config >> 16) & 0xf, (rec_log.Header.Config >> 20) & 0xf,
+			REC_CONFIG & 0xffff, (REC_CONFIG >> 16) & 0xf, (REC_CONFIG >> 20) & 0xf);
+		return 2;
+	}
+
+	Init_Buck_HBLED();
+	Control_Load_State(&rec_log.Header.State);
+
+	for (k = 0; k < rec_log.Header.NumWords; k++) {
+		w = rec_log.Words[k];
+		if (REC_IS_EVENT(w)) {
+			len = REC_EVENT_LEN(w);
+			if (k + len >= rec_log.Header.NumWords)
+				break; // Log filled up inside event
+			if (verbose)
+				printf("sample %u: event %u\n", num_samples, REC_EVENT_TYPE(w));
+			Apply_Event(REC_EVENT_TYPE(w), &rec_log.Words[k+1]);
+			k += len;
+			continue;
+		}
+		ADC0->R[0] = REC_SAMPLE_ADC(w);
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		Control_HBLED();
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		ns += (t1.tv_sec - t0.tv_sec)*1e9 + (t1.tv_nsec - t0.tv_nsec);
+
+		cnv = REC_SAMPLE_CNV(TPM0->CONTROLS[PWM_HBLED_CHANNEL].CnV);
+		if (cnv != REC_SAMPLE_CNV(w)) {
+			if (mismatches < MAX_SHOWN_MISMATCHES)
+				printf("sample %u: adc %u, recorded %u, replayed %u\n", num_samples,
+					REC_SAMPLE_ADC(w), REC_SAMPLE_CNV(w), cnv);
+			mismatches++;
+		}
+		if (out != NULL)
+			fprintf(out, "%u,%u,%u,%u\n", num_samples, REC_SAMPLE_ADC(w), REC_SAMPLE_CNV(w), cnv);
+		num_samples++;
+	}
+	if (out != NULL)
+		fclose(out);
+
+	printf("%u samples, mode %d, %u mismatches, %.0f ns per Control_HBLED call on host\n",
+		num_samples, rec_log.Header.State.Mode, mismatches, num_samples? ns/num_samples : 0.0);
+	return (mismatches == 0)? 0 : 1;
+}
@@ -0,0 +1,53 @@
+/* Peripherals, RTOS calls and firmware globals needed to run control.c 
+natively. Register writes land in RAM and are inspected by the simulator. */
+#include <stdint.h>
+#include <MKL25Z4.h>
+#include <cmsis_os2.h>
+
+#include "control.h"
+#include "timers.h"
+
+ADC_Type SIM_ADC0;
+TPM_Type SIM_TPM0, SIM_TPM1, SIM_TPM2;
+GPIO_Type SIM_PTA, SIM_PTB, SIM_PTC, SIM_PTD, SIM_PTE;
+PORT_Type SIM_PORTA, SIM_PORTB, SIM_PORTC, SIM_PORTD, SIM_PORTE;
+SIM_Type SIM_SIM;
+DAC_Type SIM_DAC0;
+CMP_Type SIM_CMP0;
+SysTick_Type SIM_SysTick = {0, 47999, 0, 0}; // 1 ms tick at 48 MHz
+
+uint32_t SystemCoreClock = 48000000;
+
+// Defined in main.c and threads.c on target
+volatile CTL_MODE_E control_mode = DEF_CONTROL_MODE;
+osMessageQueueId_t q_read_TS, q_post_ADC;
+
+osStatus_t osDelay(uint32_t ticks) {
+	return osOK;
+}
+
+osStatus_t osMessageQueuePut(osMessageQueueId_t mq_id, const void * msg_ptr, uint8_t msg_prio, uint32_t timeout) {
+	return osOK;
+}
+
+osStatus_t osMessageQueueGet(osMessageQueueId_t mq_id, void * msg_ptr, uint8_t * msg_prio, uint32_t timeout) {
+	return osErrorTimeout;
+}
+
+uint32_t osMessageQueueGetCount(osMessageQueueId_t mq_id) {
+	return 0; // No touchscreen conversions requested
+}
+
+uint32_t osKernelGetSysTimerCount(void) {
+	return 0;
+}
+
+void PWM_Init(TPM_Type * TPM, uint8_t channel_num, uint16_t period, uint16_t duty, 
+	uint8_t pos_polarity, uint8_t prescaler_code) {
+	TPM->MOD = period;
+	TPM->CONTROLS[channel_num].CnV = duty;
+}
+
+void PWM_Set_Value(TPM_Type * TPM, uint8_t channel_num, uint16_t value) {
+	TPM->CONTROLS[channel_num].CnV = value;
+}
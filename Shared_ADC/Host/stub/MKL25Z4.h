@@ -0,0 +1,111 @@
+/* Host build stand-in for the KL25Z device header. Peripherals are plain 
+structures in RAM (defined in sim_hw.c) so firmware register accesses compile
+and run natively. Only registers and fields used by the code under test are 
+provided. Layouts are not those of the real device. */
+#ifndef MKL25Z4_H_
+#define MKL25Z4_H_
+#include <stdint.h>
+
+#define __IO volatile
+#define __I volatile // writable here, so the simulator can supply results
+#define __O volatile
+#define __inline inline
+
+typedef enum {DMA0_IRQn=0, DMA1_IRQn=1, DMA2_IRQn=2, DMA3_IRQn=3, 
+	ADC0_IRQn=15, CMP0_IRQn=16, TPM0_IRQn=17, TPM1_IRQn=18, TPM2_IRQn=19, 
+	PIT_IRQn=22, SysTick_IRQn=-1} IRQn_Type;
+
+typedef struct { __IO uint32_t SC1[2]; __IO uint32_t CFG1, CFG2; __I uint32_t R[2]; 
+	__IO uint32_t CV1, CV2, SC2, SC3; } ADC_Type;
+typedef struct { __IO uint32_t SC, CNT, MOD; struct { __IO uint32_t CnSC, CnV; } CONTROLS[6]; 
+	__IO uint32_t STATUS, CONF; } TPM_Type;
+typedef struct { __IO uint32_t PDOR, PSOR, PCOR, PTOR, PDIR, PDDR; } GPIO_Type;
+typedef GPIO_Type FGPIO_Type;
+typedef struct { __IO uint32_t PCR[32]; __O uint32_t GPCLR, GPCHR; __IO uint32_t ISFR; } PORT_Type;
+typedef struct { __IO uint32_t SOPT1, SOPT2, SOPT4, SOPT5, SOPT7, SCGC4, SCGC5, SCGC6, SCGC7; } SIM_Type;
+typedef struct { struct { __IO uint8_t DATL, DATH; } DAT[2]; __IO uint8_t SR, C0, C1, C2; } DAC_Type;
+typedef struct { __IO uint8_t CR0, CR1, FPR, SCR, DACCR, MUXCR; } CMP_Type;
+typedef struct { __IO uint32_t CTRL, LOAD, VAL, CALIB; } SysTick_Type;
+
+extern ADC_Type SIM_ADC0;
+extern TPM_Type SIM_TPM0, SIM_TPM1, SIM_TPM2;
+extern GPIO_Type SIM_PTA, SIM_PTB, SIM_PTC, SIM_PTD, SIM_PTE;
+extern PORT_Type SIM_PORTA, SIM_PORTB, SIM_PORTC, SIM_PORTD, SIM_PORTE;
+extern SIM_Type SIM_SIM;
+extern DAC_Type SIM_DAC0;
+extern CMP_Type SIM_CMP0;
+extern SysTick_Type SIM_SysTick;
+
+#define ADC0 (&SIM_ADC0)
+#define TPM0 (&SIM_TPM0)
+#define TPM1 (&SIM_TPM1)
+#define TPM2 (&SIM_TPM2)
+#define PTA (&SIM_PTA)
+#define PTB (&SIM_PTB)
+#define PTC (&SIM_PTC)
+#define PTD (&SIM_PTD)
+#define PTE (&SIM_PTE)
+#define FPTA (&SIM_PTA)
+#define FPTB (&SIM_PTB)
+#define FPTC (&SIM_PTC)
+#define FPTD (&SIM_PTD)
+#define FPTE (&SIM_PTE)
+#define PORTA (&SIM_PORTA)
+#define PORTB (&SIM_PORTB)
+#define PORTC (&SIM_PORTC)
+#define PORTD (&SIM_PORTD)
+#define PORTE (&SIM_PORTE)
+#define SIM (&SIM_SIM)
+#define DAC0 (&SIM_DAC0)
+#define CMP0 (&SIM_CMP0)
+#define SysTick (&SIM_SysTick)
+
+extern uint32_t SystemCoreClock;
+
+static inline void NVIC_SetPriority(IRQn_Type n, uint32_t p) { (void)n; (void)p; }
+static inline void NVIC_ClearPendingIRQ(IRQn_Type n) { (void)n; }
+static inline void NVIC_EnableIRQ(IRQn_Type n) { (void)n; }
+static inline void NVIC_DisableIRQ(IRQn_Type n) { (void)n; }
+static inline void __disable_irq(void) { }
+static inline void __enable_irq(void) { }
+
+#define ADC_SC1_AIEN(x) (((uint32_t)(x))<<6)
+#define ADC_SC1_AIEN_MASK (1u<<6)
+#define ADC_SC1_COCO_MASK (1u<<7)
+#define ADC_SC1_ADCH_MASK (0x1Fu)
+#define ADC_SC1_ADCH(x) ((uint32_t)(x))
+#define ADC_SC2_ADTRG(x) (((uint32_t)(x))<<6)
+#define ADC_SC2_REFSEL(x) ((uint32_t)(x))
+#define ADC_SC2_ADTRG_MASK (1u<<6)
+#define ADC_SC2_ADACT_MASK (1u<<7)
+#define TPM_SC_TOF_MASK (1u<<7)
+#define TPM_CnSC_CHF_MASK (1u<<7)
+#define TPM_CnSC_CHIE_MASK (1u<<6)
+#define TPM_CnSC_MSB_MASK (1u<<5)
+#define SIM_SOPT7_ADC0TRGSEL(x) ((uint32_t)(x))
+#define SIM_SOPT7_ADC0ALTTRGEN_MASK (1u<<7)
+#define SIM_SCGC4_CMP_MASK (1u<<19)
+#define SIM_SCGC5_PORTE_MASK (1u<<13)
+#define SIM_SCGC6_ADC0_MASK (1u<<27)
+#define SIM_SCGC6_DAC0_MASK (1u<<31)
+#define PORT_PCR_MUX_MASK (0x700u)
+#define PORT_PCR_MUX_SHIFT (8)
+#define PORT_PCR_MUX(x) (((uint32_t)(x))<<8)
+#define PORT_PCR_PE_MASK (1u<<1)
+#define DAC_C0_DACEN_MASK (1u<<7)
+#define DAC_C0_DACRFS_MASK (1u<<6)
+#define CMP_CR0_HYSTCTR(x) ((uint8_t)(x))
+#define CMP_CR0_FILTER_CNT(x) ((uint8_t)((x)<<4))
+#define CMP_CR1_EN_MASK (1u<<0)
+#define CMP_CR1_PMODE_MASK (1u<<4)
+#define CMP_SCR_COUT_MASK (1u<<0)
+#define CMP_SCR_CFF_MASK (1u<<1)
+#define CMP_SCR_CFR_MASK (1u<<2)
+#define CMP_SCR_IER_MASK (1u<<4)
+#define CMP_DACCR_DACEN_MASK (1u<<7)
+#define CMP_DACCR_VRSEL_MASK (1u<<6)
+#define CMP_DACCR_VOSEL(x) ((uint8_t)(x))
+#define CMP_MUXCR_PSEL(x) ((uint8_t)((x)<<3))
+#define CMP_MUXCR_MSEL(x) ((uint8_t)(x))
+
+#endif // MKL25Z4_H_
@@ -0,0 +1,17 @@
+/* Host build stand-in for the CMSIS-RTOS2 API. The simulator calls the 
+firmware's periodic thread bodies itself, so these do nothing useful. */
+#ifndef CMSIS_OS2_H_
+#define CMSIS_OS2_H_
+#include <stdint.h>
+#include <stddef.h>
+
+typedef void * osMessageQueueId_t;
+typedef enum {osOK=0, osError=-1, osErrorTimeout=-2} osStatus_t;
+
+osStatus_t osDelay(uint32_t ticks);
+osStatus_t osMessageQueuePut(osMessageQueueId_t mq_id, const void * msg_ptr, uint8_t msg_prio, uint32_t timeout);
+osStatus_t osMessageQueueGet(osMessageQueueId_t mq_id, void * msg_ptr, uint8_t * msg_prio, uint32_t timeout);
+uint32_t osMessageQueueGetCount(osMessageQueueId_t mq_id);
+uint32_t osKernelGetSysTimerCount(void);
+
+#endif // CMSIS_OS2_H_
@@ -47,6 +47,17 @@ void LCD_Plot_Packed_Pixels_Unaligned(uint8_t fill_byte, uint8_t r_shift, PT_T *
 
  void LCD_Write_Rectangle_Pixel(COLOR_T * color, unsigned int count);// Not ported to T6963.c yet
 
+/** Versions taking colors pre-packed for the controller, from the colors.c palette
+or Color_Pack. The COLOR_T versions pack the color and call these.
+*/
+ void LCD_Plot_Pixel_PC(PT_T * pos, const PCOLOR_T * color);								// Not ported to T6963.c yet
+ void LCD_Fill_Rectangle_PC(PT_T * p1, PT_T * p2, const PCOLOR_T * color);		// Not ported to T6963.c yet
+ void LCD_Write_Rectangle_Pixel_PC(const PCOLOR_T * color, unsigned int count);// Not ported to T6963.c yet
+
+/** Write a w*h block of RGB565 pixels (as in PCOLOR_T.C16), row by row, to the rectangle from p1 to p2
+*/
+ void LCD_Blit_565(PT_T * p1, PT_T * p2, const uint16_t * pixels);						// Not ported to T6963.c yet
+
  void LCD_Set_BL(uint8_t on);
  void LCD_Set_Backlight_Brightness(uint32_t brightness_percent);
  void LCD_Text_Set_Colors(COLOR_T * foreground, COLOR_T * background);
@@ -59,10 +70,32 @@ void LCD_Plot_Packed_Pixels_Unaligned(uint8_t fill_byte, uint8_t r_shift, PT_T *
  void LCD_Text_PrintStr(PT_T * pos, char * str);
  void LCD_Text_PrintStr_RC( uint8_t  row, uint8_t col, char *  str);
 
+// Graphics_Test time and bus writes for each group of drawing calls
+typedef enum {GT_FILL, GT_PIXELS, GT_VLINES, GT_CIRCLES, GT_LINES, GT_NUM_PHASES} GT_PHASE_E;
+extern volatile uint32_t g_graphics_test_us[GT_NUM_PHASES];
+extern volatile uint32_t g_graphics_test_writes[GT_NUM_PHASES];
+
  void Graphics_Test(void);
  void LCD_Draw_Line(PT_T * p1, PT_T * p2, COLOR_T * color);
  void LCD_Draw_Circle(PT_T * p1, int radius, COLOR_T * color, int filled);
 
+/** Time series (monotonic X) polyline, drawn as one vertical span per column.
+Points can be passed as an array, or one at a time between Start and End.
+*/
+typedef struct {
+	PT_T UL, LR; // Clipping rectangle
+	PCOLOR_T Color;
+	int NumPoints, PrevX, PrevY;
+	int X, Top, Bottom; // Column being built
+	void (*Draw_Span)(int x, int top, int bottom, const PCOLOR_T * color); // Set after Start to draw elsewhere than LCD
+} LCD_POLYLINE_T;
+
+ void LCD_Draw_Polyline(PT_T * pts, int n, PT_T * ul, PT_T * lr, COLOR_T * color);
+ void LCD_Polyline_Start(LCD_POLYLINE_T * pl, PT_T * ul, PT_T * lr, COLOR_T * color);
+ void LCD_Polyline_Start_PC(LCD_POLYLINE_T * pl, PT_T * ul, PT_T * lr, const PCOLOR_T * color);
+ void LCD_Polyline_Add(LCD_POLYLINE_T * pl, int x, int y);
+ void LCD_Polyline_End(LCD_POLYLINE_T * pl);
+
 
  void LCD_TS_Init(void);
  uint32_t LCD_TS_Read(PT_T * position);
@@ -0,0 +1,118 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <cmsis_os2.h>
+#include "MKL25Z4.h"
+
+#include "LCD.h"
+#include "LCD_driver.h"
+#include "LCD_DMA.h"
+#include "gpio_defs.h"
+
+#if USE_LCD_DMA
+
+#include "ST7789.h"
+
+#define LCD_DMA_WORDS_PER_PIXEL (4)
+#define LCD_DMA_BYTES_PER_PIXEL (4*LCD_DMA_WORDS_PER_PIXEL)
+#define LCD_DMA_MAX_FILL (0xFFFFF/LCD_DMA_BYTES_PER_PIXEL) // Pixels per transfer, BCR is 20 bits
+#define LCD_DMA_SMOD_16 (1) // Source address wraps every 16 bytes
+
+static uint32_t lcd_dma_pattern[LCD_DMA_WORDS_PER_PIXEL] __attribute__((aligned(16))); // Fill pixel
+
+static volatile uint8_t lcd_dma_busy = 0;
+static volatile uint32_t lcd_dma_fill_left = 0; // Pixels of fill not yet started
+static volatile osThreadId_t lcd_dma_waiter = NULL;
+
+void LCD_DMA_Init(void) {
+	SIM->SCGC7 |= SIM_SCGC7_DMA_MASK;
+	SIM->SCGC6 |= SIM_SCGC6_DMAMUX_MASK | SIM_SCGC6_TPM2_MASK;
+	SIM->SOPT2 |= (SIM_SOPT2_TPMSRC(1) | SIM_SOPT2_PLLFLLSEL_MASK);
+
+	LCD_DMA_TPM->SC = 0;
+	LCD_DMA_TPM->MOD = LCD_DMA_TPM_MOD;
+	LCD_DMA_TPM->CONF |= TPM_CONF_DBGMODE(3);
+
+	DMAMUX0->CHCFG[LCD_DMA_CHANNEL] = 0;
+	DMA0->DMA[LCD_DMA_CHANNEL].DAR = DMA_DAR_DAR((uint32_t) &PTC->PTOR);
+	DMAMUX0->CHCFG[LCD_DMA_CHANNEL] = DMAMUX_CHCFG_SOURCE(LCD_DMA_MUX_SOURCE) | DMAMUX_CHCFG_ENBL_MASK;
+
+	NVIC_SetPriority(DMA1_IRQn, LCD_DMA_IRQ_PRIORITY);
+	NVIC_ClearPendingIRQ(DMA1_IRQn);
+	NVIC_EnableIRQ(DMA1_IRQn);
+}
+
+/* Send bytes of words to PTOR, one per timer overflow, wrapping the source 
+address every 16 bytes. */
+static void LCD_DMA_Start(const uint32_t * words, uint32_t bytes) {
+	lcd_dma_busy = 1;
+	DMA0->DMA[LCD_DMA_CHANNEL].DSR_BCR = DMA_DSR_BCR_DONE_MASK; // Clear status
+	DMA0->DMA[LCD_DMA_CHANNEL].SAR = DMA_SAR_SAR((uint32_t) words);
+	DMA0->DMA[LCD_DMA_CHANNEL].DSR_BCR = DMA_DSR_BCR_BCR(bytes);
+	// 32 bit transfers, one per request, stop requests when done
+	DMA0->DMA[LCD_DMA_CHANNEL].DCR = DMA_DCR_EINT_MASK | DMA_DCR_ERQ_MASK | DMA_DCR_CS_MASK |
+		DMA_DCR_SINC_MASK | DMA_DCR_SSIZE(0) | DMA_DCR_DSIZE(0) | DMA_DCR_SMOD(LCD_DMA_SMOD_16) | DMA_DCR_D_REQ_MASK;
+	LCD_DMA_TPM->CNT = 0;
+	LCD_DMA_TPM->SC = TPM_SC_TOF_MASK | TPM_SC_DMA_MASK | TPM_SC_CMOD(1);
+}
+
+static void LCD_DMA_Start_Fill_Chunk(void) {
+	uint32_t n = lcd_dma_fill_left;
+	
+	if (n > LCD_DMA_MAX_FILL)
+		n = LCD_DMA_MAX_FILL;
+	lcd_dma_fill_left -= n;
+	LCD_DMA_Start(lcd_dma_pattern, n*LCD_DMA_BYTES_PER_PIXEL);
+}
+
+void DMA1_IRQHandler(void) {
+	DMA0->DMA[LCD_DMA_CHANNEL].DSR_BCR = DMA_DSR_BCR_DONE_MASK;
+	if (lcd_dma_fill_left > 0) { // Fill larger than one transfer
+		LCD_DMA_Start_Fill_Chunk();
+		return;
+	}
+	LCD_DMA_TPM->SC = TPM_SC_TOF_MASK; // Stop timer
+	lcd_dma_busy = 0;
+	if (lcd_dma_waiter != NULL)
+		osThreadFlagsSet(lcd_dma_waiter, LCD_DMA_EV_DONE);
+}
+
+int LCD_DMA_Busy(void) {
+	return lcd_dma_busy;
+}
+
+/* Return once the bus is free. Threads sleep until the DMA interrupt wakes them;
+before the kernel starts this polls. */
+void LCD_DMA_Wait(void) {
+	if (!lcd_dma_busy)
+		return;
+	if (osKernelGetState() != osKernelRunning) {
+		while (lcd_dma_busy)
+			;
+		return;
+	}
+	lcd_dma_waiter = osThreadGetId();
+	while (lcd_dma_busy) // Flag may be left over from an earlier wait
+		osThreadFlagsWait(LCD_DMA_EV_DONE, osFlagsWaitAny, osWaitForever);
+	lcd_dma_waiter = NULL;
+}
+
+static __inline uint32_t LCD_DMA_Bus_Byte(void) {
+	return (FPTC->PDOR & LCD_DATA_MASK) >> LCD_DB8_POS;
+}
+
+/* Write n pixels of the color with bytes b1, b2 in the background. The bus must be
+free, with D/C set for data and a memory write started. */
+void LCD_DMA_Fill(uint8_t b1, uint8_t b2, uint32_t n) {
+	uint32_t t = ((b1 ^ b2) << LCD_DB8_POS) | MASK(LCD_NWR_POS);
+
+	// Pattern starts and ends with b2 on the bus
+	FPTC->PTOR = (LCD_DMA_Bus_Byte() ^ b2) << LCD_DB8_POS;
+	lcd_dma_pattern[0] = t; // b1, /WR low
+	lcd_dma_pattern[1] = MASK(LCD_NWR_POS); // /WR high
+	lcd_dma_pattern[2] = t; // b2, /WR low
+	lcd_dma_pattern[3] = MASK(LCD_NWR_POS);
+	lcd_dma_fill_left = n;
+	LCD_DMA_Start_Fill_Chunk();
+}
+
+#endif // USE_LCD_DMA
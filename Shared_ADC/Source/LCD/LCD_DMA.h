@@ -0,0 +1,49 @@
+#ifndef LCD_DMA_H
+#define LCD_DMA_H
+
+#include <stdint.h>
+#include "LCD_driver.h"
+
+/* Background writes to the ST7789 parallel bus. Each bus byte is two 32 bit words
+written by DMA to PTC->PTOR: the first toggles the data bits that change and
+drives /WR low, the second drives /WR high, latching the byte. Toggling leaves
+the other port C pins (touchscreen) alone. One word is sent per overflow of
+LCD_DMA_TPM, which keeps the DMA from hogging the bus and meets the controller's
+write cycle time.
+
+A fill repeats a 4 word pattern (one pixel) with the source address modulo, so
+it needs no CPU time once started. At about 1 Mpixel/s it is several times 
+slower than the CPU's 4-5 Mpixel/s, but other threads run meanwhile, so only 
+large fills (clearing the screen or plot) use it. Blits stay on the CPU: 
+expanding pixels into words costs more than writing them to the bus.
+
+Only one-color 16 bit pixel fills use DMA. Every other bus access in ST7789.c
+waits for the DMA to finish first.
+
+Off by default: the screen thread's next bus access follows a fill almost at 
+once, so it waits out the whole slow transfer (about 24 ms to clear the plot,
+against 5 ms on the CPU). Enable only once hardware timing (e.g. with 
+USE_LCD_FILL_BENCHMARK) shows other work overlapping the fill. */
+
+#define USE_LCD_DMA (0)
+
+#if USE_LCD_DMA && (LCD_CONTROLLER != CTLR_ILI9341) && (LCD_CONTROLLER != CTLR_ST7789)
+#error "USE_LCD_DMA needs the ILI9341/ST7789 parallel bus"
+#endif
+
+#define LCD_DMA_CHANNEL (1) // Channel 0 is used for sound
+#define LCD_DMA_TPM (TPM2)
+#define LCD_DMA_MUX_SOURCE (56) // TPM2 overflow
+#define LCD_DMA_TPM_MOD (11) // Word every 12 clocks (250 ns), so 1 Mpixel/s
+#define LCD_DMA_IRQ_PRIORITY (192) // Lowest, only chains fill chunks
+
+#define LCD_DMA_MIN_FILL (16384) // Pixels. Smaller fills are done by the CPU
+
+#define LCD_DMA_EV_DONE (0x100) // Thread flag set for thread in LCD_DMA_Wait
+
+void LCD_DMA_Init(void);
+int LCD_DMA_Busy(void);
+void LCD_DMA_Wait(void);
+void LCD_DMA_Fill(uint8_t b1, uint8_t b2, uint32_t n);
+
+#endif // LCD_DMA_H
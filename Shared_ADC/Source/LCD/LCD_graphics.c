@@ -1,13 +1,41 @@
+#include <stddef.h>
+#include <cmsis_os2.h>
 #include "LCD.h"
 #include "LCD_driver.h"
 
 #include "ST7789.h"
 #include "T6963.h"
+#include "LCD_DMA.h"
 
-#define DRAW_RUNS_AS_LINES (0)
 #define STEP 8
 
+volatile uint32_t g_graphics_test_us[GT_NUM_PHASES];
+volatile uint32_t g_graphics_test_writes[GT_NUM_PHASES];
 
+static uint32_t gt_start, gt_start_writes;
+
+static void GT_Start(void) {
+#if USE_LCD_DMA
+	LCD_DMA_Wait();
+#endif
+	gt_start = osKernelGetSysTimerCount();
+#if (LCD_CONTROLLER == CTLR_ILI9341) || (LCD_CONTROLLER == CTLR_ST7789)
+	gt_start_writes = g_lcd_bus_writes;
+#endif
+}
+
+static void GT_Stop(GT_PHASE_E phase) {
+#if USE_LCD_DMA
+	LCD_DMA_Wait();
+#endif
+	g_graphics_test_us[phase] = ((uint64_t) (osKernelGetSysTimerCount() - gt_start)*1000000)/osKernelGetSysTimerFreq();
+#if (LCD_CONTROLLER == CTLR_ILI9341) || (LCD_CONTROLLER == CTLR_ST7789)
+	g_graphics_test_writes[phase] = g_lcd_bus_writes - gt_start_writes;
+#endif
+}
+
+/* Draw test patterns, recording how long each group takes in g_graphics_test_us.
+Needs the kernel running for the system timer. */
 void Graphics_Test(void) {
 	int x, y, r;
 	PT_T p1, p2;
@@ -21,14 +49,17 @@ void Graphics_Test(void) {
 	c.G = 255;
 	c.B = 255;
 
+	GT_Start();
 	LCD_Fill_Buffer(&c);
 	LCD_Refresh();
 
 	c.G = 0;
 	LCD_Fill_Buffer(&c);
 	LCD_Refresh();
+	GT_Stop(GT_FILL);
 
 	c.G = 255;
+	GT_Start();
 	p1.X = p1.Y = 0;
 	for (x = 0; x<LCD_WIDTH; x++) {
 		p1.X++;
@@ -37,8 +68,10 @@ void Graphics_Test(void) {
 		LCD_Plot_Pixel(&p1, &c);
 		LCD_Refresh();
 	}
+	GT_Stop(GT_PIXELS);
 	
 	// vertical lines
+	GT_Start();
 	p1.Y = 0;
 	p2.Y = LCD_HEIGHT-1;
 	for (x=0; x<LCD_WIDTH; x += 1) {
@@ -46,6 +79,7 @@ void Graphics_Test(void) {
 		LCD_Draw_Line(&p1, &p2, &c);
 		LCD_Refresh();
 	}
+	GT_Stop(GT_VLINES);
 	
 	p1.X = LCD_WIDTH/2;
 	p1.Y = LCD_HEIGHT/2;
@@ -53,6 +87,7 @@ void Graphics_Test(void) {
 
 	// Do circles	
 	// Time filled circles
+	GT_Start();
 	for (r = 100; r>8; r -= 1) {
 		LCD_Draw_Circle(&p1, r, &c, 1);
 		LCD_Refresh();
@@ -67,8 +102,10 @@ void Graphics_Test(void) {
 		LCD_Draw_Circle(&p1, 5 + x/10, &c, 1);
 		LCD_Refresh();
 	}
+	GT_Stop(GT_CIRCLES);
 	
 	// Time drawing lines radiating from center
+	GT_Start();
 	p1.X = LCD_WIDTH/2;
 	p1.Y = LCD_HEIGHT/2;
 	
@@ -109,6 +146,7 @@ void Graphics_Test(void) {
 		LCD_Draw_Line(&p1, &p2, &c);
 		LCD_Refresh();
 	}
+	GT_Stop(GT_LINES);
 
 #if 0 	
 	// Dither test
@@ -135,21 +173,34 @@ void Graphics_Test(void) {
 	
 }
 
+/* Draw a run of len pixels from p, stepping by (dx, dy) with one of them zero, as
+one rectangle. Leaves p at the pixel after the run. */
+static void LCD_Draw_Run(PT_T * p, int len, int dx, int dy, const PCOLOR_T * color) {
+	PT_T e;
+	
+	if (len <= 0)
+		return;
+	e.X = p->X + dx*(len - 1);
+	e.Y = p->Y + dy*(len - 1);
+	LCD_Fill_Rectangle_PC(p, &e, color);
+	p->X = e.X + dx;
+	p->Y = e.Y + dy;
+}
+
 void LCD_Draw_Line(PT_T * p1, PT_T * p2, COLOR_T * color)
 // Scan line conversion code from Michael Abrash
 {
 	PT_T p;
-#if DRAW_RUNS_AS_LINES
-	PT_T pe;
-#endif
+	PCOLOR_T pc;
 	
   int Temp, AdjUp, AdjDown, ErrorTerm, XAdvance, XDelta, YDelta;	 
-  int WholeStep, InitialPixelCount, FinalPixelCount, i,j, RunLength;
+  int WholeStep, InitialPixelCount, FinalPixelCount, i, RunLength;
   int XStart;
   int YStart;
   int XEnd;
   int YEnd;
 
+	Color_Pack(color, &pc);
   XStart = p1->X;
   YStart = p1->Y;
   XEnd = p2->X;
@@ -189,33 +240,13 @@ void LCD_Draw_Line(PT_T * p1, PT_T * p2, COLOR_T * color)
 	 
   /* Vertical Line case */
   if (XDelta == 0) {
-    /* Vertical line */
-#if DRAW_RUNS_AS_LINES
-		pe.X = XEnd;
-		pe.Y = YEnd;
-		LCD_Fill_Rectangle(&p, &pe, color);
-#else		
-    for (i = 0; i <= YDelta; i++) {
-				p.Y++;
-				LCD_Plot_Pixel(&p, color);
-     }
-#endif
+		LCD_Draw_Run(&p, YDelta + 1, 0, 1, &pc);
     return;
   }
   
   /* Horizontal Line Case */
   if (YDelta == 0) {
-    /* Horizontal line */
-#if DRAW_RUNS_AS_LINES
-		pe.X = XEnd;
-		pe.Y = YEnd;
-		LCD_Fill_Rectangle(&p, &pe, color);
-#else
-    for (i = 0; i <= XDelta; i++) {
-				LCD_Plot_Pixel(&p, color);
-				p.X += XAdvance;
-    }  
-#endif
+		LCD_Draw_Run(&p, XDelta + 1, XAdvance, 0, &pc);
     return;
   }
    
@@ -224,7 +255,7 @@ void LCD_Draw_Line(PT_T * p1, PT_T * p2, COLOR_T * color)
     /* Diagonal line */
     for (i = 0; i <= XDelta; i++)
       {
-				LCD_Plot_Pixel(&p, color);
+				LCD_Plot_Pixel_PC(&p, &pc);
 				p.X += XAdvance;
 				p.Y++;
       }
@@ -232,7 +263,10 @@ void LCD_Draw_Line(PT_T * p1, PT_T * p2, COLOR_T * color)
   }
    
    
-  /* Determine whether the line is X or Y major, and handle accordingly */
+  /* Determine whether the line is X or Y major, and handle accordingly.
+  ** Each run is sent as one rectangle (a single window and burst write) rather
+  ** than pixel by pixel.
+  */
   if (XDelta >= YDelta) {
     /* X major line */
     /* Minimum # of pixels in a run in this line */
@@ -276,23 +310,7 @@ void LCD_Draw_Line(PT_T * p1, PT_T * p2, COLOR_T * color)
       ErrorTerm += YDelta;
     
     /* Draw the first, partial run of pixels */
-		#if DRAW_RUNS_AS_LINES // TODO: Fixing here
-		p.X = XStart;
-		p.Y = pe.Y = YStart;
-		if (XAdvance > 0) {
-			pe.X = XStart + InitialPixelCount;
-			LCD_Fill_Rectangle(&p, &pe, color);
-		} else {
-			pe.X = XStart - InitialPixelCount;
-			LCD_Fill_Rectangle(&pe, &p, color);
-		}
-		p.X = pe.X;
-#else
-    for (j = 0; j < InitialPixelCount; j++) {
-			LCD_Plot_Pixel(&p, color);
-			p.X += XAdvance;
-		}
-#endif
+		LCD_Draw_Run(&p, InitialPixelCount, XAdvance, 0, &pc);
     p.Y++;
     
     /* Draw all full runs */
@@ -307,34 +325,12 @@ void LCD_Draw_Line(PT_T * p1, PT_T * p2, COLOR_T * color)
 			}
 
 			/* Draw this scan line's run */
-#if DRAW_RUNS_AS_LINES
-			pe.Y = p.Y;
-			pe.X = p.X + RunLength;
-			LCD_Fill_Rectangle(&p, &pe, color);
-			p.X = pe.X;
-#else
-			for (j = 0; j < RunLength; j++) {
-				LCD_Plot_Pixel(&p, color);
-				p.X += XAdvance;
-			}
-#endif
+			LCD_Draw_Run(&p, RunLength, XAdvance, 0, &pc);
 			p.Y++;
 		}
     
     /* Draw the final run of pixels */
-#if DRAW_RUNS_AS_LINES
-		pe.Y = p.Y;
-		pe.X = pe.X + FinalPixelCount;
-		LCD_Fill_Rectangle(&p, &pe, color);
-		p.X = pe.X;
-#else
-    for (j = 0; j < FinalPixelCount; j++) {
-			LCD_Plot_Pixel(&p, color);
-			p.X += XAdvance;
-		}
-#endif
-    p.Y++;
-    
+		LCD_Draw_Run(&p, FinalPixelCount, XAdvance, 0, &pc);
     return;
   } else {
     /* Y major line */
@@ -382,19 +378,9 @@ void LCD_Draw_Line(PT_T * p1, PT_T * p2, COLOR_T * color)
 			}
       
       /* Draw the first, partial run of pixels */
-#if DRAW_RUNS_AS_LINES
-			p.X = pe.X = XStart;
-			p.Y = YStart;
-			pe.Y = YStart + InitialPixelCount;
-			LCD_Fill_Rectangle(&p, &pe, color);
-#else
-      for (j = 0; j < InitialPixelCount; j++) {
-				LCD_Plot_Pixel(&p, color);
-				p.Y++;
-			}
+			LCD_Draw_Run(&p, InitialPixelCount, 0, 1, &pc);
       /* Update x,y position */
       p.X += XAdvance;
-#endif
       
       /* Draw all full runs */
       for (i = 0; i < (XDelta - 1); i++) {
@@ -409,54 +395,129 @@ void LCD_Draw_Line(PT_T * p1, PT_T * p2, COLOR_T * color)
 				}
 				
 				/* Draw this scan line's run */
-#if DRAW_RUNS_AS_LINES
-				p.X = pe.X = XStart;
-				p.Y = YStart;
-				pe.Y = YStart + RunLength;
-				LCD_Fill_Rectangle(&p, &pe, color);
-#else
-				for (j = 0; j < RunLength; j++) {
-					LCD_Plot_Pixel(&p, color);
-					p.Y++;
-				}
+				LCD_Draw_Run(&p, RunLength, 0, 1, &pc);
 				/* Update x,y position */
 				p.X += XAdvance;
-#endif
 			}
       
       /* Draw the final run of pixels */
-#if DRAW_RUNS_AS_LINES
-			p.X = pe.X= XStart;
-			p.Y = YStart;
-			pe.Y = YStart + FinalPixelCount;
-			LCD_Fill_Rectangle(&p, &pe, color);
-#else
-      for (j= 0; j < FinalPixelCount; j++) {
-				LCD_Plot_Pixel(&p, color);
-				p.Y++;
-			}
-      /* Update x,y position */
-      p.X += XAdvance;
-#endif    
+			LCD_Draw_Run(&p, FinalPixelCount, 0, 1, &pc);
       return;
 	}
 }
 
-/* Draw a circle at coordinates xm, ym with radius r and specified color c. */
+/* Divide rounding to nearest, for d > 0. */
+static __inline int Div_Round(int n, int d) {
+	return (n >= 0)? (n + d/2)/d : -((-n + d/2)/d);
+}
+
+/* Send the column being built as one vertical span, clipped. */
+static void LCD_Polyline_Flush(LCD_POLYLINE_T * pl) {
+	PT_T p1, p2;
+	int top = MAX(pl->Top, (int) pl->UL.Y), bottom = MIN(pl->Bottom, (int) pl->LR.Y);
+
+	if ((pl->X >= (int) pl->UL.X) && (pl->X <= (int) pl->LR.X) && (top <= bottom)) {
+		if (pl->Draw_Span != NULL) {
+			(*pl->Draw_Span)(pl->X, top, bottom, &pl->Color);
+		} else {
+			p1.X = p2.X = pl->X;
+			p1.Y = top;
+			p2.Y = bottom;
+			LCD_Fill_Rectangle_PC(&p1, &p2, &pl->Color);
+		}
+	}
+	pl->Top = INT16_MAX;
+	pl->Bottom = INT16_MIN;
+}
+
+static __inline void LCD_Polyline_Extend(LCD_POLYLINE_T * pl, int y1, int y2) {
+	pl->Top = MIN(pl->Top, MIN(y1, y2));
+	pl->Bottom = MAX(pl->Bottom, MAX(y1, y2));
+}
+
+/* Start a polyline clipped to the rectangle from ul to lr. */
+void LCD_Polyline_Start(LCD_POLYLINE_T * pl, PT_T * ul, PT_T * lr, COLOR_T * color) {
+	PCOLOR_T pc;
+	
+	Color_Pack(color, &pc);
+	LCD_Polyline_Start_PC(pl, ul, lr, &pc);
+}
+
+/* As LCD_Polyline_Start, with a pre-packed color. */
+void LCD_Polyline_Start_PC(LCD_POLYLINE_T * pl, PT_T * ul, PT_T * lr, const PCOLOR_T * color) {
+	pl->UL = *ul;
+	pl->LR = *lr;
+	pl->Color = *color;
+	pl->Draw_Span = NULL;
+	pl->NumPoints = 0;
+	pl->Top = INT16_MAX;
+	pl->Bottom = INT16_MIN;
+}
+
+/* Add the next point. x must not be less than that of the previous point. 
+All of the line in one column is merged into one vertical span, which is sent
+when the line leaves the column. Each part of a segment is drawn in the column
+where it lies, so steep segments meet without gaps or doubled pixels. */
+void LCD_Polyline_Add(LCD_POLYLINE_T * pl, int x, int y) {
+	int x0 = pl->PrevX, y0 = pl->PrevY, dx = x - x0, dy = y - y0, ya, yb;
+
+	if (pl->NumPoints++ == 0) {
+		pl->X = x;
+	} else if (dx > 0) {
+		for (ya = y0; pl->X < x; ya = yb) {
+			yb = y0 + Div_Round(dy*(pl->X + 1 - x0), dx); // where the next column starts
+			LCD_Polyline_Extend(pl, ya, (yb > ya)? yb-1 : (yb < ya)? yb+1 : yb);
+			LCD_Polyline_Flush(pl);
+			pl->X++;
+		}
+	}
+	LCD_Polyline_Extend(pl, y, y);
+	pl->PrevX = x;
+	pl->PrevY = y;
+}
+
+/* Send the last column. */
+void LCD_Polyline_End(LCD_POLYLINE_T * pl) {
+	if (pl->NumPoints > 0)
+		LCD_Polyline_Flush(pl);
+	pl->NumPoints = 0;
+}
+
+/* Draw a time series of n points with non-decreasing x, clipped to the rectangle 
+from ul to lr, using one LCD window and memory write per column instead of 
+one per pixel as with LCD_Draw_Line. */
+void LCD_Draw_Polyline(PT_T * pts, int n, PT_T * ul, PT_T * lr, COLOR_T * color) {
+	LCD_POLYLINE_T pl;
+	int i;
+
+	LCD_Polyline_Start(&pl, ul, lr, color);
+	for (i = 0; i < n; i++)
+		LCD_Polyline_Add(&pl, pts[i].X, pts[i].Y);
+	LCD_Polyline_End(&pl);
+}
+
+/* Draw a circle at coordinates xm, ym with radius r and specified color c. A filled
+circle is drawn as one horizontal span per row, sent when the row is first 
+reached since that is where the span is widest. */
 void LCD_Draw_Circle(PT_T * pc, int radius, COLOR_T * c, int filled) {
 	PT_T p1, p2;
+	PCOLOR_T color;
+	int last_y = -1;
   int x = -radius, y = 0, err = 2-2*radius; /* II. Quadrant */ 
   if (filled>0) { 
+		Color_Pack(c, &color);
 		do {
-      //setPixel(xm+x, ym-y); /* III. Quadrant */
-		 	p1.X=pc->X+x;
-			p1.Y=pc->Y-y;
-			p2.X=pc->X-x;
-			p2.Y=pc->Y-y;
-			LCD_Draw_Line(&p1, &p2, c);
-			p1.Y=pc->Y+y;
-			p2.Y=pc->Y+y;
-			LCD_Draw_Line(&p1, &p2, c);
+			if (y != last_y) {
+				p1.X=pc->X+x;
+				p2.X=pc->X-x;
+				p1.Y=p2.Y=pc->Y-y;
+				LCD_Fill_Rectangle_PC(&p1, &p2, &color);
+				if (y > 0) {
+					p1.Y=p2.Y=pc->Y+y;
+					LCD_Fill_Rectangle_PC(&p1, &p2, &color);
+				}
+				last_y = y;
+			}
 
 			radius = err;
       if (radius <= y) 
@@ -12,6 +12,7 @@ FONT_HEADER_T * font_header;
 GLYPH_INDEX_T * glyph_index; 
 
 COLOR_T fg, bg;
+PCOLOR_T fg_pc, bg_pc; // Packed once here rather than for every run of a glyph
 
 uint8_t G_LCD_char_width, G_LCD_char_height;
 
@@ -45,6 +46,8 @@ void LCD_Text_Set_Colors(COLOR_T * foreground, COLOR_T * background) {
 	bg.R = background->R;
 	bg.G = background->G;
 	bg.B = background->B;
+	Color_Pack(&fg, &fg_pc);
+	Color_Pack(&bg, &bg_pc);
 }
 
 void LCD_Erase(void) {
@@ -100,7 +103,7 @@ void LCD_Text_PrintChar(PT_T * pos, char ch) {
 #if BITS_PER_PIXEL == 1
 	PT_T cur_pos;
 #endif
-	COLOR_T * pixel_color;
+	const PCOLOR_T * pixel_color;
 	uint8_t bitmap_byte;
 	uint8_t glyph_width, x_bm;
 	uint32_t offset;
@@ -159,39 +162,39 @@ void LCD_Text_PrintChar(PT_T * pos, char ch) {
 			// Up to 8 bit run
 			if (bitmap_byte == 0x00) {
 				num_pixels = MIN(8,glyph_width - x_bm);
-				LCD_Write_Rectangle_Pixel(&bg, num_pixels);
+				LCD_Write_Rectangle_Pixel_PC(&bg_pc, num_pixels);
 				x_bm += num_pixels;	
 			} else if (bitmap_byte == 0xff) {
 				num_pixels = MIN(8,glyph_width - x_bm);
-				LCD_Write_Rectangle_Pixel(&fg, num_pixels);
+				LCD_Write_Rectangle_Pixel_PC(&fg_pc, num_pixels);
 				x_bm += num_pixels;	
 			} else {
 				col = 0;
 				num_pixels = 0;
 				if ((bitmap_byte & 0x7f) == 0) {		// Up to 7 bit run
 					num_pixels = MIN(7,glyph_width - x_bm);
-					LCD_Write_Rectangle_Pixel(&bg, num_pixels);
+					LCD_Write_Rectangle_Pixel_PC(&bg_pc, num_pixels);
 				} else if ((bitmap_byte & 0x7f) == 0x7f) {
 					num_pixels = MIN(7,glyph_width - x_bm);
-					LCD_Write_Rectangle_Pixel(&fg, num_pixels);
+					LCD_Write_Rectangle_Pixel_PC(&fg_pc, num_pixels);
 				} else if ((bitmap_byte & 0x3f) == 0) { // Up to 6 bit run
 					num_pixels = MIN(6,glyph_width - x_bm);
-					LCD_Write_Rectangle_Pixel(&bg, num_pixels);
+					LCD_Write_Rectangle_Pixel_PC(&bg_pc, num_pixels);
 				} else if ((bitmap_byte & 0x3f) == 0x3f) {
 					num_pixels = MIN(6,glyph_width - x_bm);
-					LCD_Write_Rectangle_Pixel(&fg, num_pixels);
+					LCD_Write_Rectangle_Pixel_PC(&fg_pc, num_pixels);
 				} else if ((bitmap_byte & 0x1f) == 0) { // Up to 5 bit run
 					num_pixels = MIN(5,glyph_width - x_bm);
-					LCD_Write_Rectangle_Pixel(&bg, num_pixels);
+					LCD_Write_Rectangle_Pixel_PC(&bg_pc, num_pixels);
 				} else if ((bitmap_byte & 0x1f) == 0x1f) {
 					num_pixels = MIN(5,glyph_width - x_bm);
-					LCD_Write_Rectangle_Pixel(&fg, num_pixels);
+					LCD_Write_Rectangle_Pixel_PC(&fg_pc, num_pixels);
 				} else if ((bitmap_byte & 0x0f) == 0) {	// Up to 4 bit run
 					num_pixels = MIN(4,glyph_width - x_bm);
-					LCD_Write_Rectangle_Pixel(&bg, num_pixels);
+					LCD_Write_Rectangle_Pixel_PC(&bg_pc, num_pixels);
 				} else if ((bitmap_byte & 0x0f) == 0x0f) {
 					num_pixels = MIN(4,glyph_width - x_bm);
-					LCD_Write_Rectangle_Pixel(&fg, num_pixels);
+					LCD_Write_Rectangle_Pixel_PC(&fg_pc, num_pixels);
 				}
 				if (num_pixels > 0) {
 					x_bm += num_pixels;	// Advance position in glyph bitmap
@@ -200,10 +203,10 @@ void LCD_Text_PrintChar(PT_T * pos, char ch) {
 				}
 				for (; (x_bm < glyph_width) && (col < 8); col++) { // Remaining pixels in byte
 					if (bitmap_byte & 0x01) // if pixel is to be set
-						pixel_color = &fg;
+						pixel_color = &fg_pc;
 					else
-						pixel_color = &bg;
-					LCD_Write_Rectangle_Pixel(pixel_color, 1);
+						pixel_color = &bg_pc;
+					LCD_Write_Rectangle_Pixel_PC(pixel_color, 1);
 					bitmap_byte >>= 1;
 					x_bm++;
 				}
@@ -212,7 +215,7 @@ void LCD_Text_PrintChar(PT_T * pos, char ch) {
 		} while (x_bm < glyph_width);
 		if (x_bm < CHAR_WIDTH) {
 			// fill in rest of cell with background color for narrow glyphs
-			LCD_Write_Rectangle_Pixel(&bg, CHAR_WIDTH - x_bm);	
+			LCD_Write_Rectangle_Pixel_PC(&bg_pc, CHAR_WIDTH - x_bm);	
 		}
 	}
 #endif // BPP != 1
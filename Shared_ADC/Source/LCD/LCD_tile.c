@@ -0,0 +1,142 @@
+#include <stdint.h>
+#include <stddef.h>
+
+#include "LCD.h"
+#include "LCD_tile.h"
+
+#if USE_LCD_TILES
+
+typedef enum {TILE_CMD_RECT, TILE_CMD_TRACE} TILE_CMD_E;
+
+typedef struct {
+	uint8_t Type; // TILE_CMD_E
+	PCOLOR_T Color;
+	int16_t X1, Y1, X2, Y2; // Rectangle, or bounds of trace
+	int N, XNum, XDen; // Trace: point i is at column UL.X + i*XNum/XDen
+	TILE_Y_FN_T Y;
+	const void * Arg;
+} TILE_CMD_T;
+
+static TILE_CMD_T tile_cmds[TILE_MAX_CMDS];
+static int tile_num_cmds;
+static PT_T tile_ul, tile_lr;
+static PCOLOR_T tile_bg;
+static uint16_t * tile_buf; // Band being composed, stride is region width
+static int tile_y0, tile_stride, tile_rows; // Top row, width and height of band
+
+/* Start listing commands for the region from ul to lr, cleared to background.
+buf holds buf_pixels, at least one row of the region (the region is cut to fit),
+and must not be used otherwise until Tile_Render returns. */
+void Tile_Begin(PT_T * ul, PT_T * lr, const PCOLOR_T * background, uint16_t * buf, int buf_pixels) {
+	tile_ul = *ul;
+	tile_lr = *lr;
+	if ((int)(tile_lr.X - tile_ul.X + 1) > buf_pixels)
+		tile_lr.X = tile_ul.X + buf_pixels - 1;
+	tile_rows = buf_pixels/(tile_lr.X - tile_ul.X + 1);
+	tile_bg = *background;
+	tile_buf = buf;
+	tile_num_cmds = 0;
+}
+
+static TILE_CMD_T * Tile_New_Cmd(int type, const PCOLOR_T * color) {
+	TILE_CMD_T * c;
+	
+	if (tile_num_cmds >= TILE_MAX_CMDS)
+		return NULL;
+	c = &tile_cmds[tile_num_cmds++];
+	c->Type = type;
+	c->Color = *color;
+	return c;
+}
+
+void Tile_Add_Rect(PT_T * p1, PT_T * p2, const PCOLOR_T * color) {
+	TILE_CMD_T * c = Tile_New_Cmd(TILE_CMD_RECT, color);
+	
+	if (c == NULL)
+		return;
+	c->X1 = MIN(p1->X, p2->X);
+	c->X2 = MAX(p1->X, p2->X);
+	c->Y1 = MIN(p1->Y, p2->Y);
+	c->Y2 = MAX(p1->Y, p2->Y);
+}
+
+/* Add a polyline of n points, with point i at column i*x_num/x_den of the region
+and row y(arg, i). The points are read once here to find the rows the trace 
+covers, then again for each band it crosses. */
+void Tile_Add_Trace(int n, int x_num, int x_den, TILE_Y_FN_T y, const void * arg, const PCOLOR_T * color) {
+	TILE_CMD_T * c = Tile_New_Cmd(TILE_CMD_TRACE, color);
+	int i, v;
+	
+	if (c == NULL)
+		return;
+	c->N = n;
+	c->XNum = x_num;
+	c->XDen = x_den;
+	c->Y = y;
+	c->Arg = arg;
+	c->Y1 = INT16_MAX;
+	c->Y2 = INT16_MIN;
+	for (i = 0; i < n; i++) {
+		v = (*y)(arg, i);
+		if (v < 0)
+			continue;
+		c->Y1 = MIN(c->Y1, v);
+		c->Y2 = MAX(c->Y2, v);
+	}
+}
+
+/* Polyline output into the band. Already clipped to it. */
+static void Tile_Span(int x, int top, int bottom, const PCOLOR_T * color) {
+	uint16_t * p = &tile_buf[(top - tile_y0)*tile_stride + x - tile_ul.X];
+	
+	for (; top <= bottom; top++, p += tile_stride)
+		*p = color->C16;
+}
+
+static void Tile_Draw_Cmd(TILE_CMD_T * c, PT_T * ul, PT_T * lr) {
+	LCD_POLYLINE_T pl;
+	int i, v, y1, y2, x1, x2;
+	
+	if (c->Type == TILE_CMD_RECT) {
+		x1 = MAX(c->X1, (int) ul->X);
+		x2 = MIN(c->X2, (int) lr->X);
+		y1 = MAX(c->Y1, (int) ul->Y);
+		y2 = MIN(c->Y2, (int) lr->Y);
+		for (i = x1; i <= x2; i++)
+			Tile_Span(i, y1, y2, &c->Color);
+	} else {
+		LCD_Polyline_Start_PC(&pl, ul, lr, &c->Color);
+		pl.Draw_Span = Tile_Span;
+		for (i = 0; i < c->N; i++) {
+			v = (*c->Y)(c->Arg, i);
+			if (v >= 0)
+				LCD_Polyline_Add(&pl, tile_ul.X + i*c->XNum/c->XDen, v);
+		}
+		LCD_Polyline_End(&pl);
+	}
+}
+
+/* Compose and send the region band by band. */
+void Tile_Render(void) {
+	PT_T ul, lr;
+	int i, n;
+	TILE_CMD_T * c;
+	
+	ul.X = tile_ul.X;
+	lr.X = tile_lr.X;
+	tile_stride = lr.X - ul.X + 1;
+	for (tile_y0 = tile_ul.Y; tile_y0 <= (int) tile_lr.Y; tile_y0 += tile_rows) {
+		ul.Y = tile_y0;
+		lr.Y = MIN(tile_y0 + tile_rows - 1, (int) tile_lr.Y);
+		n = tile_stride*(lr.Y - ul.Y + 1);
+		for (i = 0; i < n; i++)
+			tile_buf[i] = tile_bg.C16;
+		for (c = tile_cmds; c < &tile_cmds[tile_num_cmds]; c++) {
+			if ((c->Y2 >= (int) ul.Y) && (c->Y1 <= (int) lr.Y))
+				Tile_Draw_Cmd(c, &ul, &lr);
+		}
+		LCD_Blit_565(&ul, &lr, tile_buf);
+	}
+}
+
+#endif // USE_LCD_TILES
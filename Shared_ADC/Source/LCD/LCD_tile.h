@@ -0,0 +1,31 @@
+#ifndef LCD_TILE_H
+#define LCD_TILE_H
+
+#include <stdint.h>
+#include "LCD.h"
+
+/* Strip-tile renderer. There is no room for a frame buffer, so the draw commands
+for one rectangular region are listed first, then Tile_Render composes them 
+into a small RGB565 buffer one band of rows at a time, sending each band with 
+one LCD window and one burst write. Each pixel is sent once, with no
+background fill before the traces, so a region redrawn this way doesn't flicker.
+Commands are drawn in the order added, and those outside a band are skipped.
+The caller supplies the band buffer, so it can share storage with state that
+is idle while the region is drawn. A band is as many full rows of the region
+as fit in the buffer. */
+
+#define USE_LCD_TILES (1) // Slider, and the Average and Equiv time views
+#define TILE_WIDTH (240)
+#define TILE_ROWS (2)
+#define TILE_BUF_PIXELS (TILE_ROWS*TILE_WIDTH) // 0.9 KB, for a full width region
+#define TILE_MAX_CMDS (8)
+
+// Screen row of point i of a trace, or negative to leave the point out
+typedef int (*TILE_Y_FN_T)(const void * arg, int i);
+
+void Tile_Begin(PT_T * ul, PT_T * lr, const PCOLOR_T * background, uint16_t * buf, int buf_pixels);
+void Tile_Add_Rect(PT_T * p1, PT_T * p2, const PCOLOR_T * color);
+void Tile_Add_Trace(int n, int x_num, int x_den, TILE_Y_FN_T y, const void * arg, const PCOLOR_T * color);
+void Tile_Render(void);
+
+#endif // LCD_TILE_H
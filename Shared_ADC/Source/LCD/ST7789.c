@@ -16,9 +16,38 @@
 #if ((LCD_CONTROLLER == CTLR_ILI9341) || (LCD_CONTROLLER == CTLR_ST7789))
 
 #include "ST7789.h"
+#include "LCD_DMA.h"
 
 extern void Delay(uint32_t);
 
+volatile uint32_t g_lcd_bus_writes=0; // Command and data bytes sent to controller
+
+// Address window and write pointer the controller has now, so unchanged 
+// addresses aren't sent again
+static struct {
+	uint16_t C_Min, C_Max, R_Min, R_Max;
+	uint16_t C, R; // Next pixel of memory write in progress
+	uint8_t Valid; // Window known
+	uint8_t Writing; // Memory write in progress and C, R known
+	uint32_t Remaining; // Pixels left in memory write, for 12 bit packing
+} lcd_win;
+
+static uint8_t lcd_color_bits = 16; // Pixel format, 16 (RGB565) or 12 (RGB444)
+
+// In 12 bit mode two pixels are sent in three bytes, so the last pixel of an 
+// odd run waits here for the first of the next run
+static uint16_t lcd_pending; // RGB444
+static uint8_t lcd_have_pending = 0;
+
+static void LCD_24S_Flush_Pending(void);
+
+// CPU bus accesses wait for a background DMA write to finish
+#if USE_LCD_DMA
+#define LCD_24S_Wait_Bus() LCD_DMA_Wait()
+#else
+#define LCD_24S_Wait_Bus()
+#endif
+
 const LCD_CTLR_INIT_SEQ_T Init_Seq_ILI9341[] = {
 	{LCD_CTRL_INIT_SEQ_CMD, 0x28}, 	
 	{LCD_CTRL_INIT_SEQ_CMD, 0x11}, 	{LCD_CTRL_INIT_SEQ_DAT, 0x00}, 
@@ -122,6 +151,11 @@ void LCD_Set_Backlight_Brightness(uint32_t brightness_percent){
 /* Write one byte as a command to the TFT LCD controller. */
 static void LCD_24S_Write_Command(uint8_t command)
 {
+	if (lcd_have_pending)
+		LCD_24S_Flush_Pending();
+	LCD_24S_Wait_Bus();
+	g_lcd_bus_writes++;
+	lcd_win.Writing = 0; // Any command ends a memory write
 	GPIO_ResetBit(LCD_D_NC_POS);
 	GPIO_Write(command);
 	GPIO_ResetBit(LCD_NWR_POS);
@@ -131,15 +165,208 @@ static void LCD_24S_Write_Command(uint8_t command)
 /* Write one byte as data to the TFT LCD Controller. */
 static void LCD_24S_Write_Data(uint8_t data)
 {
+	LCD_24S_Wait_Bus();
+	g_lcd_bus_writes++;
 	GPIO_SetBit(LCD_D_NC_POS);
 	GPIO_Write(data);
 	GPIO_ResetBit(LCD_NWR_POS);
 	GPIO_SetBit(LCD_NWR_POS);
 }
 
+/* Burst writes. D/C is set once per transaction, and each byte is put on the
+data bus with one store to PTOR, toggling only the data bits which differ from
+the byte before, instead of clearing and then setting them in PDOR. Other port
+C pins are left alone. Each byte takes at least 4 cycles (83 ns at 48 MHz), 
+more than the controller's 66 ns write cycle. */
+static __inline uint32_t LCD_24S_Bus_Byte(void) {
+	return (FPTC->PDOR & LCD_DATA_MASK) >> LCD_DB8_POS;
+}
+
+static void LCD_24S_Write_Data_Burst(const uint8_t * data, uint32_t n) {
+	uint32_t prev;
+	
+	LCD_24S_Wait_Bus();
+	g_lcd_bus_writes += n;
+	GPIO_SetBit(LCD_D_NC_POS);
+	prev = LCD_24S_Bus_Byte();
+	while (n--) {
+		FPTC->PTOR = (prev ^ *data) << LCD_DB8_POS;
+		prev = *data++;
+		GPIO_ResetBit(LCD_NWR_POS);
+		GPIO_SetBit(LCD_NWR_POS);
+	}
+}
+
+/* Write n pixels of one color, given as its two bytes. If they are equal the 
+bus is set once and only /WR toggles, otherwise every byte toggles the same bits. */
+static void LCD_24S_Write_Color_Burst(uint8_t b1, uint8_t b2, uint32_t n) {
+	uint32_t t;
+	
+	if (n == 0)
+		return;
+	LCD_24S_Wait_Bus();
+	g_lcd_bus_writes += 2*n;
+	GPIO_SetBit(LCD_D_NC_POS);
+#if USE_LCD_DMA
+	if (n >= LCD_DMA_MIN_FILL) {
+		LCD_DMA_Fill(b1, b2, n);
+		return;
+	}
+#endif
+	FPTC->PTOR = (LCD_24S_Bus_Byte() ^ b1) << LCD_DB8_POS;
+	if (b1 == b2) {
+		n *= 2;
+		while (n--) {
+			GPIO_ResetBit(LCD_NWR_POS);
+			GPIO_SetBit(LCD_NWR_POS);
+		}
+	} else {
+		t = (b1 ^ b2) << LCD_DB8_POS;
+		while (n--) {
+			GPIO_ResetBit(LCD_NWR_POS);
+			GPIO_SetBit(LCD_NWR_POS);
+			FPTC->PTOR = t;
+			GPIO_ResetBit(LCD_NWR_POS);
+			GPIO_SetBit(LCD_NWR_POS);
+			FPTC->PTOR = t;
+		}
+	}
+}
+
+/* Write n RGB565 pixels from memory. */
+static void LCD_24S_Write_Pixels_Burst(const uint16_t * pixels, uint32_t n) {
+	uint32_t prev, b;
+	
+	LCD_24S_Wait_Bus();
+	g_lcd_bus_writes += 2*n;
+	GPIO_SetBit(LCD_D_NC_POS);
+	prev = LCD_24S_Bus_Byte();
+	while (n--) {
+		b = *pixels >> 8;
+		FPTC->PTOR = (prev ^ b) << LCD_DB8_POS;
+		GPIO_ResetBit(LCD_NWR_POS);
+		GPIO_SetBit(LCD_NWR_POS);
+		prev = *pixels++ & 0xff;
+		FPTC->PTOR = (b ^ prev) << LCD_DB8_POS;
+		GPIO_ResetBit(LCD_NWR_POS);
+		GPIO_SetBit(LCD_NWR_POS);
+	}
+}
+
+/* Write n repetitions of three bytes, for pairs of 12 bit pixels. As for 
+two-byte colors, if all bytes are equal only /WR toggles. */
+static void LCD_24S_Write_Triple_Burst(uint8_t x0, uint8_t x1, uint8_t x2, uint32_t n) {
+	uint32_t t01, t12, t20;
+	
+	if (n == 0)
+		return;
+	LCD_24S_Wait_Bus();
+	g_lcd_bus_writes += 3*n;
+	GPIO_SetBit(LCD_D_NC_POS);
+	FPTC->PTOR = (LCD_24S_Bus_Byte() ^ x0) << LCD_DB8_POS;
+	if ((x0 == x1) && (x1 == x2)) {
+		n *= 3;
+		while (n--) {
+			GPIO_ResetBit(LCD_NWR_POS);
+			GPIO_SetBit(LCD_NWR_POS);
+		}
+	} else {
+		t01 = (x0 ^ x1) << LCD_DB8_POS;
+		t12 = (x1 ^ x2) << LCD_DB8_POS;
+		t20 = (x2 ^ x0) << LCD_DB8_POS;
+		while (n--) {
+			GPIO_ResetBit(LCD_NWR_POS);
+			GPIO_SetBit(LCD_NWR_POS);
+			FPTC->PTOR = t01;
+			GPIO_ResetBit(LCD_NWR_POS);
+			GPIO_SetBit(LCD_NWR_POS);
+			FPTC->PTOR = t12;
+			GPIO_ResetBit(LCD_NWR_POS);
+			GPIO_SetBit(LCD_NWR_POS);
+			FPTC->PTOR = t20;
+		}
+	}
+}
+
+/* Send a pending 12 bit pixel on its own, as two bytes. */
+static void LCD_24S_Flush_Pending(void) {
+	uint8_t d[2];
+	
+	lcd_have_pending = 0;
+	d[0] = lcd_pending >> 4;
+	d[1] = (lcd_pending & 0x0f) << 4;
+	LCD_24S_Write_Data_Burst(d, 2);
+}
+
+/* Write a run of n pixels of one color in the current pixel format. */
+static void LCD_24S_Write_Color_Run(const PCOLOR_T * color, uint32_t n) {
+	uint8_t d[3];
+	uint16_t c;
+	
+	if (lcd_color_bits == 16) {
+		LCD_24S_Write_Color_Burst(color->C16 >> 8, color->C16 & 0xff, n);
+		return;
+	}
+	if (n == 0)
+		return;
+	// 12 bpp, 4-4-4, pairs packed as R1G1 B1R2 G2B2
+	c = color->C12;
+	lcd_win.Remaining -= MIN(n, lcd_win.Remaining);
+	if (lcd_have_pending) { // Complete the pair
+		lcd_have_pending = 0;
+		d[0] = lcd_pending >> 4;
+		d[1] = ((lcd_pending & 0x0f) << 4) | (c >> 8);
+		d[2] = c & 0xff;
+		LCD_24S_Write_Data_Burst(d, 3);
+		n--;
+	}
+	LCD_24S_Write_Triple_Burst(c >> 4, ((c & 0x0f) << 4) | (c >> 8), c & 0xff, n/2);
+	if (n & 1) {
+		lcd_pending = c;
+		lcd_have_pending = 1;
+		if (lcd_win.Remaining == 0) // Nothing to pair it with
+			LCD_24S_Flush_Pending();
+	}
+}
+
+/* Start a memory write of n pixels at the top left of the window. */
+static void LCD_24S_Start_Memory_Write(uint32_t n) {
+	LCD_24S_Write_Command(0x002c);
+	lcd_win.Remaining = n;
+}
+
+/* Set the column and page (row) address window for following memory writes,
+sending only the address range which differs from the window already set. */
+static void LCD_24S_Set_Window(uint16_t c_min, uint16_t c_max, uint16_t r_min, uint16_t r_max) {
+	uint8_t d[4];
+	
+	if (!lcd_win.Valid || (c_min != lcd_win.C_Min) || (c_max != lcd_win.C_Max)) {
+		d[0] = c_min >> 8;
+		d[1] = c_min & 0xff;
+		d[2] = c_max >> 8;
+		d[3] = c_max & 0xff;
+		LCD_24S_Write_Command(0x002A); //column address set
+		LCD_24S_Write_Data_Burst(d, 4);
+		lcd_win.C_Min = c_min;
+		lcd_win.C_Max = c_max;
+	}
+	if (!lcd_win.Valid || (r_min != lcd_win.R_Min) || (r_max != lcd_win.R_Max)) {
+		d[0] = r_min >> 8;
+		d[1] = r_min & 0xff;
+		d[2] = r_max >> 8;
+		d[3] = r_max & 0xff;
+		LCD_24S_Write_Command(0x002B); //page address set
+		LCD_24S_Write_Data_Burst(d, 4);
+		lcd_win.R_Min = r_min;
+		lcd_win.R_Max = r_max;
+	}
+	lcd_win.Valid = 1;
+}
+
 void LCD_Controller_Init(const LCD_CTLR_INIT_SEQ_T init_seq[]) {
 	unsigned i=0, done=0;
 	
+	lcd_win.Valid = 0;
 	GPIO_SetBit(LCD_NRD_POS);
 	GPIO_ResetBit(LCD_NWR_POS);
 	GPIO_ResetBit(LCD_NRST_POS);
@@ -173,77 +400,70 @@ void LCD_Init(void)
 	LCD_GPIO_Init();
 	LCD_TS_Init(); // Commented out to leave ADC for HBLED control system
 	LCD_Init_Backlight();
+#if USE_LCD_DMA
+	LCD_DMA_Init();
+#endif
 
 #if LCD_CONTROLLER == CTLR_ILI9341
 	LCD_Controller_Init(Init_Seq_ILI9341);
 #else
 	LCD_Controller_Init(Init_Seq_ST7789);
 #endif
-	
+	LCD_Set_Color_Bits(LCD_COLOR_BITS);
 }
 
 /* Set the pixel at pos to the given color. */
 void LCD_Plot_Pixel(PT_T * pos, COLOR_T * color) {
-	uint8_t b1, b2;
-
-	// Column address set 0x2a
-	LCD_24S_Write_Command(0x002A); //column address set
-	LCD_24S_Write_Data(0);
-	LCD_24S_Write_Data(pos->X & 0xff); //start 
-	LCD_24S_Write_Data(0x0000);
-	LCD_24S_Write_Data(0x00EF); //end 0x00EF
+	PCOLOR_T pc;
 	
-	// Page (row) address set 0x2b
-	LCD_24S_Write_Command(0x002B); //page address set
-	LCD_24S_Write_Data(pos->Y >> 8);
-	LCD_24S_Write_Data(pos->Y & 0xff); //start 
-	LCD_24S_Write_Data(0x0001);
-	LCD_24S_Write_Data(0x003F); //end 0x013F	
-	
-	// Memory Write 0x2c
-	// 16 bpp, 5-6-5. Assume color channel data is left-aligned
-	b1 = (color->R&0xf8) | ((color->G&0xe0)>>5);
-	b2 = ((color->G&0x1c)<<3) | ((color->B&0xf8)>>3);
+	Color_Pack(color, &pc);
+	LCD_Plot_Pixel_PC(pos, &pc);
+}
 
-	LCD_24S_Write_Command(0x002c);
-	LCD_24S_Write_Data(b1);
-	LCD_24S_Write_Data(b2);
+/* Set the pixel at pos to the given pre-packed color. The window runs from pos to the
+bottom right of the display, so if the next pixel plotted is the one after 
+this in the same row, it is written without any address or memory write 
+commands. A pixel in the same column or row only needs one address command. */
+void LCD_Plot_Pixel_PC(PT_T * pos, const PCOLOR_T * color) {
+	if (!lcd_win.Writing || (pos->X != lcd_win.C) || (pos->Y != lcd_win.R)) {
+		LCD_24S_Set_Window(pos->X, LCD_WIDTH-1, pos->Y, LCD_HEIGHT-1);
+		LCD_24S_Start_Memory_Write(1);
+		// 12 bit pixels go in pairs, so there a lone pixel ends the memory write
+		lcd_win.Writing = (lcd_color_bits == 16);
+		lcd_win.C = pos->X;
+		lcd_win.R = pos->Y;
+	}
+	LCD_24S_Write_Color_Run(color, 1);
+	
+	if (++lcd_win.C > lcd_win.C_Max) { // Write pointer wraps to next row of window
+		lcd_win.C = lcd_win.C_Min;
+		if (++lcd_win.R > lcd_win.R_Max)
+			lcd_win.Writing = 0;
+	}
 }
 
 /* Fill the entire display buffer with the given color. */
 void LCD_Fill_Buffer(COLOR_T * color) {
-	uint32_t x, y;
-	uint8_t b1, b2;
+	PCOLOR_T pc;
 	
+	Color_Pack(color, &pc);
 	// Enable access to full screen, reset write pointer to origin
-	LCD_24S_Write_Command(0x002A); //column address set
-	LCD_24S_Write_Data(0x0000);
-	LCD_24S_Write_Data(0x0000); //start 0x0000
-	LCD_24S_Write_Data(0x0000);
-	LCD_24S_Write_Data(0x00EF); //end 0x00EF
-	LCD_24S_Write_Command(0x002B); //page address set
-	LCD_24S_Write_Data(0x0000);
-	LCD_24S_Write_Data(0x0000); //start 0x0000
-	LCD_24S_Write_Data(0x0001);
-	LCD_24S_Write_Data(0x003F); //end 0x013F
-	
-	// Memory Write 0x2c
-	// 16 bpp, 5-6-5. Assume color channel data is left-aligned
-	b1 = (color->R&0xf8) | ((color->G&0xe0)>>5);
-	b2 = ((color->G&0x1c)<<3) | ((color->B&0xf8)>>3);
-	
-	LCD_24S_Write_Command(0x002c);
-	for (y=0; y<320; y++) {
-		for (x=0; x<240; x++) {
-			LCD_24S_Write_Data(b1);
-			LCD_24S_Write_Data(b2);
-		}
-	}		
+	LCD_24S_Set_Window(0, LCD_WIDTH-1, 0, LCD_HEIGHT-1);
+	LCD_24S_Start_Memory_Write(LCD_WIDTH*LCD_HEIGHT);
+	LCD_24S_Write_Color_Run(&pc, LCD_WIDTH*LCD_HEIGHT);
 }
+
 /* Draw a rectangle from p1 to p2 filled with specified color. */
 void LCD_Fill_Rectangle(PT_T * p1, PT_T * p2, COLOR_T * color) {
+	PCOLOR_T pc;
+	
+	Color_Pack(color, &pc);
+	LCD_Fill_Rectangle_PC(p1, p2, &pc);
+}
+
+/* Draw a rectangle from p1 to p2 filled with specified pre-packed color. */
+void LCD_Fill_Rectangle_PC(PT_T * p1, PT_T * p2, const PCOLOR_T * color) {
 	uint32_t n;
-	uint8_t b1, b2;
 	uint16_t c_min, c_max, r_min, r_max;
 	
 	c_min = MIN(p1->X, p2->X);
@@ -254,33 +474,13 @@ void LCD_Fill_Rectangle(PT_T * p1, PT_T * p2, COLOR_T * color) {
 	r_max = MAX(p1->Y, p2->Y);
 	r_max = MIN(r_max, LCD_HEIGHT-1);
 
-	n = (c_max - c_min + 1)*(r_max - r_min + 1);
-	if (n == 0)
+	if ((c_min > c_max) || (r_min > r_max)) // Entirely off screen
 		return;
+	n = (c_max - c_min + 1)*(r_max - r_min + 1);
 	
-	// Enable access to full screen, reset write pointer to origin
-	LCD_24S_Write_Command(0x002A); //column address set
-	LCD_24S_Write_Data(c_min >> 8);
-	LCD_24S_Write_Data(c_min & 0xff); //start 
-	LCD_24S_Write_Data(c_max >> 8);
-	LCD_24S_Write_Data(c_max & 0xff); //end 
-	LCD_24S_Write_Command(0x002B); //page address set
-	LCD_24S_Write_Data(r_min >> 8);
-	LCD_24S_Write_Data(r_min & 0xff); //start 
-	LCD_24S_Write_Data(r_max >> 8);
-	LCD_24S_Write_Data(r_max & 0xff); //end 
-	
-	// Memory Write 0x2c
-	// 16 bpp, 5-6-5. Assume color channel data is left-aligned
-	b1 = (color->R&0xf8) | ((color->G&0xe0)>>5);
-	b2 = ((color->G&0x1c)<<3) | ((color->B&0xf8)>>3);
-	
-	LCD_24S_Write_Command(0x002c);
-	
-	while (n-- > 0) {
-		LCD_24S_Write_Data(b1);
-		LCD_24S_Write_Data(b2);
-	}	
+	LCD_24S_Set_Window(c_min, c_max, r_min, r_max);
+	LCD_24S_Start_Memory_Write(n);
+	LCD_24S_Write_Color_Run(color, n);
 }
 
 /* Prepare LCD controller draw rectangle from p1 to p2 using future pixels provided 
@@ -304,20 +504,8 @@ uint32_t LCD_Start_Rectangle(PT_T * p1, PT_T * p2) {
 	
 	n = (c_max - c_min + 1)*(r_max - r_min + 1);
 	if (n > 0) {
-		// Enable access to full screen, reset write pointer to origin
-		LCD_24S_Write_Command(0x002A); //column address set
-		LCD_24S_Write_Data(c_min >> 8);
-		LCD_24S_Write_Data(c_min & 0xff); //start 
-		LCD_24S_Write_Data(c_max >> 8);
-		LCD_24S_Write_Data(c_max & 0xff); //end 
-		LCD_24S_Write_Command(0x002B); //page address set
-		LCD_24S_Write_Data(r_min >> 8);
-		LCD_24S_Write_Data(r_min & 0xff); //start 
-		LCD_24S_Write_Data(r_max >> 8);
-		LCD_24S_Write_Data(r_max & 0xff); //end 
-		
-		// Memory Write 0x2c
-		LCD_24S_Write_Command(0x002c);
+		LCD_24S_Set_Window(c_min, c_max, r_min, r_max);
+		LCD_24S_Start_Memory_Write(n);
 	}	
 	return n;
 }
@@ -325,17 +513,95 @@ uint32_t LCD_Start_Rectangle(PT_T * p1, PT_T * p2) {
 /* Plot this pixel in the next location as defined by LCD_Start_Rectangle. You must 
 have called LCD_Write_Rectangle before calling this function. */
 void LCD_Write_Rectangle_Pixel(COLOR_T * color, unsigned int count) {
-	uint8_t b1, b2;
-
-	// 16 bpp, 5-6-5. Assume color channel data is left-aligned
-	b1 = (color->R&0xf8) | ((color->G&0xe0)>>5);
-	b2 = ((color->G&0x1c)<<3) | ((color->B&0xf8)>>3);
-	while (count--) {
-		LCD_24S_Write_Data(b1);
-		LCD_24S_Write_Data(b2);
+	PCOLOR_T pc;
+	
+	Color_Pack(color, &pc);
+	LCD_24S_Write_Color_Run(&pc, count);
+}
+
+/* As LCD_Write_Rectangle_Pixel, with a pre-packed color. */
+void LCD_Write_Rectangle_Pixel_PC(const PCOLOR_T * color, unsigned int count) {
+	LCD_24S_Write_Color_Run(color, count);
+}
+
+/* Select 16 bit (RGB565) or 12 bit (RGB444) pixels. The 12 bit format sends 
+three bytes per two pixels instead of four. Pixels already in frame memory
+aren't converted, so choose before drawing. COLOR_T is the same in both. */
+void LCD_Set_Color_Bits(int bits) {
+	lcd_color_bits = (bits == 12)? 12 : 16;
+	LCD_24S_Write_Command(0x003A); // interface pixel format
+	LCD_24S_Write_Data((lcd_color_bits == 12)? 0x53 : 0x55);
+}
+
+/* Send a block of RGB565 pixels to the rectangle from p1 to p2 (not clipped) with
+one window and one memory write. In 12 bit mode each pixel is converted. */
+void LCD_Blit_565(PT_T * p1, PT_T * p2, const uint16_t * pixels) {
+	uint32_t n;
+	PCOLOR_T pc;
+	
+	n = (p2->X - p1->X + 1)*(p2->Y - p1->Y + 1);
+	LCD_24S_Set_Window(p1->X, p2->X, p1->Y, p2->Y);
+	LCD_24S_Start_Memory_Write(n);
+	if (lcd_color_bits == 16) {
+		LCD_24S_Write_Pixels_Burst(pixels, n);
+		return;
 	}
+	while (n--) {
+		pc.C12 = ((*pixels >> 4) & 0xf00) | ((*pixels >> 3) & 0x0f0) | ((*pixels >> 1) & 0x00f);
+		pixels++;
+		LCD_24S_Write_Color_Run(&pc, 1);
+	}
+}
+
+/* Define the vertical scrolling area as frame memory rows top to top+height-1.
+Rows above and below it are fixed. Scrolling is along the controller's row axis,
+which is the long axis of the panel. */
+void LCD_Set_Scroll_Area(uint16_t top, uint16_t height) {
+	uint16_t bottom = LCD_HEIGHT - top - height;
+	
+	LCD_24S_Write_Command(0x0033); // vertical scrolling definition
+	LCD_24S_Write_Data(top >> 8);
+	LCD_24S_Write_Data(top & 0xff); // top fixed area
+	LCD_24S_Write_Data(height >> 8);
+	LCD_24S_Write_Data(height & 0xff); // scrolling area
+	LCD_24S_Write_Data(bottom >> 8);
+	LCD_24S_Write_Data(bottom & 0xff); // bottom fixed area
+}
+
+/* Show frame memory row 'row' on the first line of the scrolling area, with the
+following rows of the area below it, wrapping around. Setting it to the top of 
+the area shows the frame memory unscrolled. */
+void LCD_Set_Scroll_Start(uint16_t row) {
+	LCD_24S_Write_Command(0x0037); // vertical scroll start address
+	LCD_24S_Write_Data(row >> 8);
+	LCD_24S_Write_Data(row & 0xff);
 }
 
+#if USE_LCD_FILL_BENCHMARK
+volatile uint32_t g_lcd_fill_rate[2]; // Pixels per second
+
+/* Time LCD_Fill_Buffer with a color of two different bytes (red), then one of
+equal bytes (white, then black to leave the screen blank). Needs the kernel 
+running for the system timer. */
+void LCD_Fill_Benchmark(void) {
+	uint32_t i, start, ticks;
+	
+	start = osKernelGetSysTimerCount();
+	for (i=0; i<LCD_BENCH_FILLS; i++)
+		LCD_Fill_Buffer(&red);
+	LCD_24S_Wait_Bus();
+	ticks = osKernelGetSysTimerCount() - start;
+	g_lcd_fill_rate[0] = ((uint64_t) LCD_BENCH_FILLS*LCD_WIDTH*LCD_HEIGHT*osKernelGetSysTimerFreq())/ticks;
+	
+	start = osKernelGetSysTimerCount();
+	for (i=0; i<LCD_BENCH_FILLS; i++)
+		LCD_Fill_Buffer((i == LCD_BENCH_FILLS-1)? &black : &white);
+	LCD_24S_Wait_Bus();
+	ticks = osKernelGetSysTimerCount() - start;
+	g_lcd_fill_rate[1] = ((uint64_t) LCD_BENCH_FILLS*LCD_WIDTH*LCD_HEIGHT*osKernelGetSysTimerFreq())/ticks;
+}
+#endif
+
 void LCD_Refresh(void) {
 	// Empty, since no local frame buffer used
 }
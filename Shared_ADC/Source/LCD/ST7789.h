@@ -9,6 +9,7 @@
 #define LCD_HEIGHT (320)
 
 #define BITS_PER_PIXEL				(24)
+#define LCD_COLOR_BITS (16) // Pixel format sent at init: 16 (RGB565) or 12 (RGB444)
 
 
 // TFT LCD Hardware Interface
@@ -21,6 +22,23 @@
 #define LCD_NRST_POS (17)
 #define LCD_DATA_MASK (((unsigned )0x0ff) << LCD_DB8_POS)
 
+extern volatile uint32_t g_lcd_bus_writes; // for profiling drawing code
+
+// Fill speed, measured once when the screen thread starts
+#define USE_LCD_FILL_BENCHMARK (0)
+#define LCD_BENCH_FILLS (4)
+
+#if USE_LCD_FILL_BENCHMARK
+extern volatile uint32_t g_lcd_fill_rate[2]; // Pixels per second: two-byte color, one-byte color
+void LCD_Fill_Benchmark(void);
+#endif
+
+void LCD_Set_Color_Bits(int bits);
+
+// Hardware vertical scrolling, in frame memory rows
+void LCD_Set_Scroll_Area(uint16_t top, uint16_t height);
+void LCD_Set_Scroll_Start(uint16_t row);
+
 #endif // LCD Controller
 
 #endif // ST7789_H
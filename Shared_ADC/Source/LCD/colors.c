@@ -1,20 +1,28 @@
 #include "colors.h"
 
-COLOR_T black={0,0,0}, 
-	white={255,255,255}, 
-	red={255,0,0},
-	green={0,255,0},
-	blue={0,0,255},
-	yellow={255,255,0},
-	cyan={0,255,255},
-	magenta={255,0,255},
-	dark_red={153,0,0}, 
-	dark_green={0,153,0},
-	dark_blue={0,0,153},
-	dark_yellow={153,153,0},
-	dark_cyan={0,153,153},
-	dark_magenta={153,0,153},
-	orange={188,124,26},
-	light_gray={110,110,110}, 
-	dark_gray={48,48,48};
-	
\ No newline at end of file
+// Each palette color is also defined pre-packed as pc_<name>
+#define DEF_COLOR(name, r, g, b) COLOR_T name = {r, g, b}; const PCOLOR_T pc_##name = PCOLOR_INIT(r, g, b)
+
+DEF_COLOR(black, 0, 0, 0);
+DEF_COLOR(white, 255, 255, 255);
+DEF_COLOR(red, 255, 0, 0);
+DEF_COLOR(green, 0, 255, 0);
+DEF_COLOR(blue, 0, 0, 255);
+DEF_COLOR(yellow, 255, 255, 0);
+DEF_COLOR(cyan, 0, 255, 255);
+DEF_COLOR(magenta, 255, 0, 255);
+DEF_COLOR(dark_red, 153, 0, 0);
+DEF_COLOR(dark_green, 0, 153, 0);
+DEF_COLOR(dark_blue, 0, 0, 153);
+DEF_COLOR(dark_yellow, 153, 153, 0);
+DEF_COLOR(dark_cyan, 0, 153, 153);
+DEF_COLOR(dark_magenta, 153, 0, 153);
+DEF_COLOR(orange, 188, 124, 26);
+DEF_COLOR(light_gray, 110, 110, 110);
+DEF_COLOR(dark_gray, 48, 48, 48);
+
+/* Pack a color for the LCD drawing functions which take PCOLOR_T. */
+void Color_Pack(COLOR_T * c, PCOLOR_T * p) {
+	p->C16 = ((c->R & 0xf8) << 8) | ((c->G & 0xfc) << 3) | (c->B >> 3);
+	p->C12 = ((c->R & 0xf0) << 4) | (c->G & 0xf0) | (c->B >> 4);
+}
@@ -25,4 +25,34 @@ extern COLOR_T black,
 	light_gray, 
 	dark_gray;
 
+/* A color pre-packed in each pixel format of the LCD controller, so drawing 
+functions which take one don't convert it for every call. */
+typedef struct {
+	uint16_t C16; // RGB565
+	uint16_t C12; // RGB444, in 12 bit mode
+} PCOLOR_T;
+
+#define PCOLOR_INIT(r, g, b) {(((r) & 0xf8) << 8) | (((g) & 0xfc) << 3) | ((b) >> 3), \
+	(((r) & 0xf0) << 4) | ((g) & 0xf0) | ((b) >> 4)}
+
+extern const PCOLOR_T pc_black,
+	pc_white,
+	pc_red,
+	pc_green,
+	pc_blue,
+	pc_yellow,
+	pc_cyan,
+	pc_magenta,
+	pc_dark_red,
+	pc_dark_green,
+	pc_dark_blue,
+	pc_dark_yellow,
+	pc_dark_cyan,
+	pc_dark_magenta,
+	pc_orange,
+	pc_light_gray,
+	pc_dark_gray;
+
+void Color_Pack(COLOR_T * c, PCOLOR_T * p);
+
 #endif // COLORS_H
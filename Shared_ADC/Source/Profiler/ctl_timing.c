@@ -0,0 +1,75 @@
+#include <stdint.h>
+#include <MKL25Z4.h>
+#include <cmsis_os2.h>
+
+#include "ctl_timing.h"
+
+CTL_TIMING_T g_ctl_timing = {CTL_TIMING_MAGIC, 0, 
+	{0xffffffff, 0, 0, 0, {0}}, 
+	{0xffffffff, 0, 0, 0, {0}}};
+volatile CTL_TIMING_SUMMARY_T g_ctl_timing_summary;
+
+static void Ctl_Timing_Reset_Stat(CTL_TIMING_STAT_T * s) {
+	int i;
+	
+	s->Min = 0xffffffff;
+	s->Max = 0;
+	for (i=0; i<CTL_TIMING_HIST_BINS; i++)
+		s->Hist[i] = 0;
+}
+
+/* Restart min, max and histograms. Running totals are left alone. */
+void Ctl_Timing_Reset(void) {
+	__disable_irq();
+	Ctl_Timing_Reset_Stat(&g_ctl_timing.ISR_Duration);
+	Ctl_Timing_Reset_Stat(&g_ctl_timing.Update_Latency);
+	__enable_irq();
+}
+
+/* Touching the ISR max field on the Timing page restarts the statistics. */
+void Ctl_Timing_Reset_Handler(UI_FIELD_T * fld, int v) {
+	Ctl_Timing_Reset();
+}
+
+/* Read running totals without locking: retry if the ISR updated them meanwhile. */
+static void Ctl_Timing_Snapshot(CTL_TIMING_STAT_T * s, uint32_t * sum, uint32_t * count) {
+	uint32_t c;
+	
+	do {
+		c = s->Count;
+		*sum = s->Sum;
+	} while (c != s->Count);
+	*count = c;
+}
+
+/* Compute means and CPU load over the time since the previous call. 
+Called from Thread_Update_Screen. */
+void Ctl_Timing_Update_Summary(void) {
+	static uint32_t prev_isr_sum=0, prev_isr_count=0, prev_lat_sum=0, prev_lat_count=0;
+	static uint32_t prev_time=0;
+	uint32_t isr_sum, isr_count, lat_sum, lat_count, now, elapsed;
+	
+	g_ctl_timing.CoreClock = SystemCoreClock;
+	now = osKernelGetSysTimerCount();
+	Ctl_Timing_Snapshot(&g_ctl_timing.ISR_Duration, &isr_sum, &isr_count);
+	Ctl_Timing_Snapshot(&g_ctl_timing.Update_Latency, &lat_sum, &lat_count);
+
+	elapsed = now - prev_time;
+	if ((isr_count != prev_isr_count) && (elapsed > 0)) {
+		g_ctl_timing_summary.ISR_Mean = (isr_sum - prev_isr_sum)/(isr_count - prev_isr_count);
+		g_ctl_timing_summary.Load_Pct = ((uint64_t)(isr_sum - prev_isr_sum)*100)/elapsed;
+	}
+	if (lat_count != prev_lat_count) {
+		g_ctl_timing_summary.Lat_Mean = (lat_sum - prev_lat_sum)/(lat_count - prev_lat_count);
+	}
+	g_ctl_timing_summary.ISR_Min = g_ctl_timing.ISR_Duration.Min;
+	g_ctl_timing_summary.ISR_Max = g_ctl_timing.ISR_Duration.Max;
+	g_ctl_timing_summary.Lat_Min = g_ctl_timing.Update_Latency.Min;
+	g_ctl_timing_summary.Lat_Max = g_ctl_timing.Update_Latency.Max;
+	
+	prev_isr_sum = isr_sum;
+	prev_isr_count = isr_count;
+	prev_lat_sum = lat_sum;
+	prev_lat_count = lat_count;
+	prev_time = now;
+}
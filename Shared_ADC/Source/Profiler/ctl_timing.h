@@ -0,0 +1,99 @@
+#ifndef CTL_TIMING_H
+#define CTL_TIMING_H
+
+#include <stdint.h>
+#include <MKL25Z4.h>
+#include "UI.h"
+
+/* Cycle-accurate timing of the control ISR. 
+Timestamps come from SysTick (core clock, reloaded every OS tick) and from
+TPM0, whose overflow triggers the ADC conversion for the control loop. 
+Statistics are in g_ctl_timing, which a debugger or host tool can read 
+directly. The block starts with CTL_TIMING_MAGIC. */
+
+#define USE_CTL_TIMING (1)
+
+#define CTL_TIMING_MAGIC (0x54494D45) // "TIME"
+#define CTL_TIMING_HIST_BINS (16)
+#define CTL_TIMING_HIST_SHIFT (4) // Bin 0 is under 16 cycles, each later bin twice as wide
+#define CTL_TIMING_CYCLES_PER_TICK (1) // TPM0 runs at the core clock (48 MHz, prescaler 1)
+
+typedef struct {
+	uint32_t Min, Max; // cycles, since reset
+	uint32_t Sum, Count; // running totals, allowed to wrap
+	uint32_t Hist[CTL_TIMING_HIST_BINS]; // log2 bins, last bin holds all longer
+} CTL_TIMING_STAT_T;
+
+typedef struct {
+	uint32_t Magic;
+	uint32_t CoreClock; // Hz
+	CTL_TIMING_STAT_T ISR_Duration; // ADC ISR entry to exit
+	CTL_TIMING_STAT_T Update_Latency; // ADC trigger (TPM0 overflow) to CnV write, cycles
+	uint32_t Entry_Time, Entry_Count; // SysTick and TPM0 count at latest ADC ISR entry
+} CTL_TIMING_T;
+
+typedef struct { // Updated by Ctl_Timing_Update_Summary for UI
+	int ISR_Min, ISR_Mean, ISR_Max; // cycles
+	int Lat_Min, Lat_Mean, Lat_Max; // cycles
+	int Load_Pct; // Percentage of CPU time spent in ADC ISR. Other ISRs are not counted.
+} CTL_TIMING_SUMMARY_T;
+
+extern CTL_TIMING_T g_ctl_timing;
+extern volatile CTL_TIMING_SUMMARY_T g_ctl_timing_summary;
+
+void Ctl_Timing_Reset(void);
+void Ctl_Timing_Reset_Handler(UI_FIELD_T * fld, int v);
+void Ctl_Timing_Update_Summary(void);
+
+/* ISR-side hooks are inlined to keep overhead to a few cycles. */
+#if USE_CTL_TIMING
+
+/* SysTick counts down. */
+static __inline uint32_t Ctl_Timing_Elapsed(uint32_t start, uint32_t end) {
+	if (end > start) // SysTick reloaded in between
+		start += SysTick->LOAD + 1;
+	return start - end;
+}
+
+/* Call at ADC ISR entry. Returns timestamp for Ctl_Timing_ISR_Exit. */
+static __inline uint32_t Ctl_Timing_ISR_Entry(void) {
+	g_ctl_timing.Entry_Time = SysTick->VAL;
+	g_ctl_timing.Entry_Count = TPM0->CNT;
+	return g_ctl_timing.Entry_Time;
+}
+
+static __inline void Ctl_Timing_Record(CTL_TIMING_STAT_T * s, uint32_t d) {
+	uint32_t bin;
+	
+	if (d < s->Min)
+		s->Min = d;
+	if (d > s->Max)
+		s->Max = d;
+	s->Sum += d;
+	s->Count++;
+	d >>= CTL_TIMING_HIST_SHIFT;
+	for (bin=0; d && (bin < CTL_TIMING_HIST_BINS-1); bin++) // No CLZ on Cortex-M0+
+		d >>= 1;
+	s->Hist[bin]++;
+}
+
+/* Call at ISR exit with timestamp from ISR entry. */
+static __inline void Ctl_Timing_ISR_Exit(uint32_t start) {
+	Ctl_Timing_Record(&g_ctl_timing.ISR_Duration, Ctl_Timing_Elapsed(start, SysTick->VAL));
+}
+
+/* Call right after writing CnV. The ADC trigger is at TPM0 count 0 and the 
+conversion finishes well within the following up-count (PWM_PERIOD ticks), so 
+the count at ISR entry is the time since trigger. Add the time since entry. */
+static __inline void Ctl_Timing_CnV_Written(void) {
+	Ctl_Timing_Record(&g_ctl_timing.Update_Latency, g_ctl_timing.Entry_Count*CTL_TIMING_CYCLES_PER_TICK
+		+ Ctl_Timing_Elapsed(g_ctl_timing.Entry_Time, SysTick->VAL));
+}
+
+#else
+#define Ctl_Timing_ISR_Entry() (0)
+#define Ctl_Timing_ISR_Exit(start)
+#define Ctl_Timing_CnV_Written()
+#endif // USE_CTL_TIMING
+
+#endif // CTL_TIMING_H
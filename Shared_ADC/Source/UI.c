@@ -1,6 +1,7 @@
 #include "UI.h"
 #include <stdio.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "LCD.h"
@@ -11,6 +12,13 @@
 #include "control.h"
 #include "FX.h"
 #include "timers.h"
+#include "ctl_timing.h"
+#include "recorder.h"
+#include "flash_metrics.h"
+#include "capture.h"
+#include "ets.h"
+#include "strip.h"
+#include "LCD_tile.h"
 
 UI_FIELD_T Fields[] = {
 	{"Duty Cycle  ", "ct", "", (volatile int *)&g_duty_cycle, NULL, {0,7}, 
@@ -31,17 +39,188 @@ UI_FIELD_T Fields[] = {
 	&light_gray, &black, 1, 0, 1, 1, NULL},
 };
 
+UI_FIELD_T Protection_Fields[] = {
+	{"HW lim trips", "", "", (volatile int *)&g_hw_limit_trips, NULL, {0,7}, 
+	&light_gray, &black, 1, 0, 1, 1, NULL},
+	{"LED fault   ", "", "", (volatile int *)&g_led_fault, NULL, {0,8}, 
+	&yellow, &black, 1, 0, 0, 1, Control_Fault_Clear_Handler},
+};
+
+UI_FIELD_T Trigger_Fields[] = {
+	{"Trig src    ", "", "", (volatile int *)&g_cap_trigger.Source, NULL, {0,7}, 
+	&yellow, &black, 1, 0, 0, 0, Capture_Config_Handler},
+	{"Trig edge   ", "", "", (volatile int *)&g_cap_trigger.Edge, NULL, {0,8}, 
+	&yellow, &black, 1, 0, 0, 0, Capture_Config_Handler},
+	{"Trig level  ", "mA", "", (volatile int *)&g_cap_trigger.Level, NULL, {0,9}, 
+	&yellow, &black, 1, 0, 0, 0, Capture_Config_Handler},
+	{"Trig hyst   ", "mA", "", (volatile int *)&g_cap_trigger.Hysteresis, NULL, {0,10}, 
+	&yellow, &black, 1, 0, 0, 0, Capture_Config_Handler},
+	{"Pre-trigger ", "smp", "", (volatile int *)&g_cap_trigger.PreTrigger, NULL, {0,11}, 
+	&yellow, &black, 1, 0, 0, 0, Capture_Config_Handler},
+	{"Trig mode   ", "", "", (volatile int *)&g_cap_trigger.Mode, NULL, {0,12}, 
+	&yellow, &black, 1, 0, 0, 0, Capture_Config_Handler},
+	{"Cap state   ", "", "", (volatile int *)&g_cap_state, NULL, {0,13}, 
+	&yellow, &black, 1, 0, 0, 1, Capture_Arm_Handler},
+};
+
+#if USE_CTL_TIMING
+UI_FIELD_T Timing_Fields[] = {
+	{"ISR min     ", "cy", "", (volatile int *)&g_ctl_timing_summary.ISR_Min, NULL, {0,7}, 
+	&light_gray, &black, 1, 0, 1, 1, NULL},
+	{"ISR mean    ", "cy", "", (volatile int *)&g_ctl_timing_summary.ISR_Mean, NULL, {0,8}, 
+	&light_gray, &black, 1, 0, 1, 1, NULL},
+	{"ISR max     ", "cy", "", (volatile int *)&g_ctl_timing_summary.ISR_Max, NULL, {0,9}, 
+	&yellow, &black, 1, 0, 0, 1, Ctl_Timing_Reset_Handler},
+	{"Upd lat min ", "cy", "", (volatile int *)&g_ctl_timing_summary.Lat_Min, NULL, {0,10}, 
+	&light_gray, &black, 1, 0, 1, 1, NULL},
+	{"Upd lat mean", "cy", "", (volatile int *)&g_ctl_timing_summary.Lat_Mean, NULL, {0,11}, 
+	&light_gray, &black, 1, 0, 1, 1, NULL},
+	{"Upd lat max ", "cy", "", (volatile int *)&g_ctl_timing_summary.Lat_Max, NULL, {0,12}, 
+	&light_gray, &black, 1, 0, 1, 1, NULL},
+	{"ADC ISR load", "%", "", (volatile int *)&g_ctl_timing_summary.Load_Pct, NULL, {0,13}, 
+	&light_gray, &black, 1, 0, 1, 1, NULL},
+};
+
+void UI_Draw_Timing_Page(void);
+#endif
+
+#if USE_CONTROL_RECORDER
+UI_FIELD_T Recorder_Fields[] = {
+	{"Rec state   ", "", "", (volatile int *)&g_rec_state, NULL, {0,7}, 
+	&yellow, &black, 1, 0, 0, 1, Rec_Arm_Handler},
+	{"Rec words   ", "", "", (volatile int *)&g_rec_log.Header.NumWords, NULL, {0,8}, 
+	&light_gray, &black, 1, 0, 1, 1, NULL},
+};
+#endif
+
+#if USE_FLASH_METRICS
+void UI_Draw_Flash_Page(void);
+#endif
+
+int UI_plot_peak = 1; // Draw min to max span of each column, else mean
+int UI_plot_spp8 = 8*CAP_DEF_DECIMATION; // Samples per pixel, in eighths
+int UI_plot_pan = 0; // First point shown
+int UI_plot_scale = 100; // Pixels per 100 mA
+int UI_plot_offset = 0; // mA at bottom of plot
+volatile int UI_plot_bus_writes = 0; // LCD bus writes to draw latest capture
+
+/* Timebase, pan and vertical scale of the plot. Zooming out makes the next 
+captures decimate more, so a capture always holds CAPTURE_DEPTH points. */
+void UI_Plot_Handler(UI_FIELD_T * fld, int v) {
+	int n, min = 0, max = INT16_MAX;
+	
+	if (fld->Val == &UI_plot_spp8) {
+		min = 1;
+		max = 8*CAP_MAX_DECIMATION;
+	} else if (fld->Val == &UI_plot_pan) {
+		max = CAPTURE_DEPTH-1; // Limited further by zoom when drawn
+	} else if (fld->Val == &UI_plot_scale) {
+		min = 1;
+	} else if (fld->Val == &UI_plot_offset) {
+		min = INT16_MIN;
+	}
+	n = *fld->Val + v/16;
+	if (n < min)
+		n = min;
+	else if (n > max)
+		n = max;
+	*fld->Val = n;
+	if (fld->Val == &UI_plot_spp8) // Round up, so the capture spans at least the screen width
+		g_cap_decimation = (n + 7)/8;
+}
+
+UI_FIELD_T Plot_Fields[] = {
+	{"Peak detect ", "", "", (volatile int *)&UI_plot_peak, NULL, {0,7}, 
+	&yellow, &black, 1, 0, 0, 0, Control_OnOff_Handler},
+	{"Smp per px  ", "/8", "", (volatile int *)&UI_plot_spp8, NULL, {0,8}, 
+	&yellow, &black, 1, 0, 0, 0, UI_Plot_Handler},
+	{"Pan         ", "pt", "", (volatile int *)&UI_plot_pan, NULL, {0,9}, 
+	&yellow, &black, 1, 0, 0, 0, UI_Plot_Handler},
+	{"V scale     ", "%", "", (volatile int *)&UI_plot_scale, NULL, {0,10}, 
+	&yellow, &black, 1, 0, 0, 0, UI_Plot_Handler},
+	{"V offset    ", "mA", "", (volatile int *)&UI_plot_offset, NULL, {0,11}, 
+	&yellow, &black, 1, 0, 0, 0, UI_Plot_Handler},
+	{"Bus writes  ", "", "", &UI_plot_bus_writes, NULL, {0,12}, 
+	&light_gray, &black, 1, 0, 1, 1, NULL},
+};
+
+#if USE_CAP_AVERAGING
+UI_FIELD_T Average_Fields[] = {
+	{"Avg count   ", "", "", (volatile int *)&g_cap_avg.Count, NULL, {0,7}, 
+	&yellow, &black, 1, 0, 0, 0, Capture_Average_Handler},
+	{"Envelope    ", "", "", (volatile int *)&g_cap_avg.Envelope, NULL, {0,8}, 
+	&yellow, &black, 1, 0, 0, 0, Capture_Average_Handler},
+	{"Avg done    ", "", "", (volatile int *)&g_cap_avg.Done, NULL, {0,9}, 
+	&light_gray, &black, 1, 0, 1, 1, NULL},
+};
+#endif
+
+#if USE_ETS_CAPTURE
+UI_FIELD_T ETS_Fields[] = {
+	{"ETS enable  ", "", "", (volatile int *)&g_ets_enable, NULL, {0,7}, 
+	&yellow, &black, 1, 0, 0, 0, ETS_Enable_Handler},
+	{"ETS phase   ", "", "", (volatile int *)&g_ets_phase, NULL, {0,8}, 
+	&light_gray, &black, 1, 0, 1, 1, NULL},
+	{"ETS pulses  ", "", "", (volatile int *)&g_ets.Pulses, NULL, {0,9}, 
+	&light_gray, &black, 1, 0, 1, 1, NULL},
+	{"ETS recons  ", "", "", (volatile int *)&g_ets.Seq, NULL, {0,10}, 
+	&light_gray, &black, 1, 0, 1, 1, NULL},
+	{"ETS missed  ", "", "", (volatile int *)&g_ets.Missed, NULL, {0,11}, 
+	&light_gray, &black, 1, 0, 1, 1, NULL},
+};
+#endif
+
+#if USE_STRIP_CHART
+volatile int UI_strip_bus_writes = 0; // LCD bus writes for latest line, including scroll
+
+UI_FIELD_T Strip_Fields[] = {
+	{"Waterfall   ", "", "", &g_strip_enable, NULL, {0,7}, 
+	&yellow, &black, 1, 0, 0, 0, Strip_Config_Handler},
+	{"Smp per line", "", "", &g_strip_decimation, NULL, {0,8}, 
+	&yellow, &black, 1, 0, 0, 0, Strip_Config_Handler},
+	{"Overruns    ", "", "", &g_strip_overruns, NULL, {0,9}, 
+	&light_gray, &black, 1, 0, 1, 1, NULL},
+	{"Bus writes  ", "", "", &UI_strip_bus_writes, NULL, {0,10}, 
+	&light_gray, &black, 1, 0, 1, 1, NULL},
+};
+
+void UI_Draw_Strip_Page(void);
+#endif
+
+UI_PAGE_T Pages[] = {
+	{"Control   ", Fields, sizeof(Fields)/sizeof(UI_FIELD_T), NULL},
+	{"Protection", Protection_Fields, sizeof(Protection_Fields)/sizeof(UI_FIELD_T), NULL},
+	{"Trigger   ", Trigger_Fields, sizeof(Trigger_Fields)/sizeof(UI_FIELD_T), NULL},
+	{"Plot      ", Plot_Fields, sizeof(Plot_Fields)/sizeof(UI_FIELD_T), NULL},
+#if USE_CAP_AVERAGING
+	{"Avg (exp) ", Average_Fields, sizeof(Average_Fields)/sizeof(UI_FIELD_T), NULL},
+#endif
+#if USE_CTL_TIMING
+	{"Timing    ", Timing_Fields, sizeof(Timing_Fields)/sizeof(UI_FIELD_T), UI_Draw_Timing_Page},
+#endif
+#if USE_FLASH_METRICS
+	{"Flash     ", NULL, 0, UI_Draw_Flash_Page},
+#endif
+#if USE_STRIP_CHART
+	{"Waterfall ", Strip_Fields, sizeof(Strip_Fields)/sizeof(UI_FIELD_T), UI_Draw_Strip_Page},
+#endif
+#if USE_ETS_CAPTURE
+	{"ETS (exp) ", ETS_Fields, sizeof(ETS_Fields)/sizeof(UI_FIELD_T), NULL},
+#endif
+#if USE_CONTROL_RECORDER
+	{"Recorder  ", Recorder_Fields, sizeof(Recorder_Fields)/sizeof(UI_FIELD_T), NULL},
+#endif
+};
+
 UI_SLIDER_T Slider = {
 	0, {0,LCD_HEIGHT-UI_SLIDER_HEIGHT}, {UI_SLIDER_WIDTH-1,LCD_HEIGHT-1}, 
 	{119,LCD_HEIGHT-UI_SLIDER_HEIGHT}, {119,LCD_HEIGHT-1}, &white, &dark_gray, &light_gray
 };
 
-extern int g_measured_accum[NUMBER_SAMPLES_NEEDED];
-extern int g_set_accum[NUMBER_SAMPLES_NEEDED];
-extern int state;
-extern int samples_taken;
 
 int UI_sel_field = -1;
+int UI_cur_page = 0;
+volatile int UI_page_changed = 0; // Set by touch thread, cleared by screen thread
 
 void UI_Update_Field_Values (UI_FIELD_T * f, int num) {
 	int i;
@@ -51,9 +230,9 @@ void UI_Update_Field_Values (UI_FIELD_T * f, int num) {
 	}	
 }
 
-void UI_Update_Volatile_Field_Values(UI_FIELD_T * f) {
+void UI_Update_Volatile_Field_Values(UI_FIELD_T * f, int num) {
 	int i;
-	for (i=0; i < UI_NUM_FIELDS; i++) {
+	for (i=0; i < num; i++) {
 		if (f[i].Volatile) {
 			snprintf(f[i].Buffer, sizeof(f[i].Buffer), "%s%4d %s", f[i].Label, f[i].Val? *(f[i].Val) : 0, f[i].Units);
 			f[i].Updated = 1;
@@ -78,25 +257,60 @@ void UI_Draw_Fields(UI_FIELD_T * f, int num){
 	}
 }
 
+#if USE_LCD_TILES
+// Columns covered by old and new bar when they overlap, in bands of 6 rows
+#define UI_SLIDER_TILE_PIXELS ((2*UI_SLIDER_BAR_WIDTH+1)*6)
+static uint16_t ui_slider_tile[UI_SLIDER_TILE_PIXELS];
+#endif
+
+/* The bar is only redrawn when it moves. If the old and new bars overlap, the 
+columns they cover are composed as a tile and sent once, so the bar doesn't 
+flicker. Otherwise the old bar is erased and the new one drawn. */
 void UI_Draw_Slider(UI_SLIDER_T * s) {
 	static int initialized=0;
+	int x = (s->LR.X - s->UL.X)/2 + s->Val - UI_SLIDER_BAR_WIDTH/2; // Left of new bar
+	PT_T old_ul = s->BarUL, old_lr = s->BarLR;
+#if USE_LCD_TILES
+	PT_T ul, lr;
+	PCOLOR_T bg, fg;
+#endif
 	
+	if (x < (int) s->UL.X) // Keep the bar on the slider
+		x = s->UL.X;
+	else if (x > (int) s->LR.X - UI_SLIDER_BAR_WIDTH)
+		x = s->LR.X - UI_SLIDER_BAR_WIDTH;
 	if (!initialized) {
 		LCD_Fill_Rectangle(&s->UL, &s->LR, s->ColorBG);
-		initialized = 1;
+	} else if (x == (int) s->BarUL.X) {
+		return;
 	}
-	LCD_Fill_Rectangle(&s->BarUL, &s->BarLR, s->ColorBG); // Erase old bar
-	
 	s->BarUL.Y = s->UL.Y;
 	s->BarLR.Y = s->LR.Y;
-	s->BarUL.X = (s->LR.X - s->UL.X)/2 + s->Val;
-	s->BarLR.X = s->BarUL.X + UI_SLIDER_BAR_WIDTH/2;
-	s->BarUL.X -= UI_SLIDER_BAR_WIDTH/2;
+	s->BarUL.X = x;
+	s->BarLR.X = x + UI_SLIDER_BAR_WIDTH;
+#if USE_LCD_TILES
+	if (initialized && (s->BarUL.X <= old_lr.X) && (old_ul.X <= s->BarLR.X)) {
+		ul.X = MIN(old_ul.X, s->BarUL.X);
+		ul.Y = s->UL.Y;
+		lr.X = MAX(old_lr.X, s->BarLR.X);
+		lr.Y = s->LR.Y;
+		Color_Pack(s->ColorBG, &bg);
+		Color_Pack(s->ColorFG, &fg);
+		Tile_Begin(&ul, &lr, &bg, ui_slider_tile, UI_SLIDER_TILE_PIXELS);
+		Tile_Add_Rect(&s->BarUL, &s->BarLR, &fg);
+		Tile_Render();
+		return;
+	}
+#endif
+	if (initialized)
+		LCD_Fill_Rectangle(&old_ul, &old_lr, s->ColorBG); // Erase old bar
 	LCD_Fill_Rectangle(&s->BarUL, &s->BarLR, s->ColorFG); // Draw new bar
+	initialized = 1;
 }
 
 int UI_Identify_Field(PT_T * p) {
 	int i, t, b, l, r;
+	UI_FIELD_T * Fields = Pages[UI_cur_page].Fields;
 
 	if ((p->X >= LCD_WIDTH) || (p->Y >= LCD_HEIGHT)) {
 		return -1;
@@ -106,7 +320,10 @@ int UI_Identify_Field(PT_T * p) {
 		&& (p->Y >= Slider.UL.Y) && (p->Y <= Slider.LR.Y)) {
 		return UI_SLIDER;
 	}
-  for (i=0; i<UI_NUM_FIELDS; i++) {
+	if (p->Y < ROW_TO_Y(1)) {
+		return UI_PAGE_SELECT;
+	}
+  for (i=0; i<Pages[UI_cur_page].NumFields; i++) {
 		l = COL_TO_X(Fields[i].RC.X);
 		r = l + strlen(Fields[i].Buffer)*CHAR_WIDTH;
 		t = ROW_TO_Y(Fields[i].RC.Y);
@@ -122,16 +339,25 @@ int UI_Identify_Field(PT_T * p) {
 
 void UI_Update_Field_Selects(int sel) {
 	int i;
-	for (i=0; i < UI_NUM_FIELDS; i++) {
+	UI_FIELD_T * Fields = Pages[UI_cur_page].Fields;
+	for (i=0; i < Pages[UI_cur_page].NumFields; i++) {
 		Fields[i].Selected = (i == sel)? 1 : 0;
 	}
 }
 
 void UI_Process_Touch(PT_T * p) {  // Called by Thread_Read_TS
 	int i;
+	UI_FIELD_T * Fields = Pages[UI_cur_page].Fields;
 	
 	i = UI_Identify_Field(p);
-	if (i == UI_SLIDER) {
+	if (i == UI_PAGE_SELECT) {
+		if (!UI_page_changed) { // Ignore touches until screen thread shows new page
+			UI_sel_field = -1;
+			UI_Update_Field_Selects(UI_sel_field);
+			UI_cur_page = (UI_cur_page + 1) % UI_NUM_PAGES;
+			UI_page_changed = 1;
+		}
+	} else if (i == UI_SLIDER) {
 		Slider.Val = p->X - (Slider.LR.X - Slider.UL.X)/2; // Determine slider position (value)
 		if (UI_sel_field >= 0) {  // If a field is selected...
 			if (Fields[UI_sel_field].Val != NULL) {
@@ -145,64 +371,521 @@ void UI_Process_Touch(PT_T * p) {  // Called by Thread_Read_TS
 		if (!Fields[i].ReadOnly) { // Can't select (and modify) a ReadOnly field
 			UI_sel_field = i;
 			UI_Update_Field_Selects(UI_sel_field);
-			UI_Update_Field_Values(Fields, UI_NUM_FIELDS);
+			UI_Update_Field_Values(Fields, Pages[UI_cur_page].NumFields);
 			Slider.Val = 0; // return to slider to zero if a different field is selected
 		}
 	} 
 }
-void UI_Draw_Current(void){
-	int measured_avg = 0;
-	int set_avg = 0;		// Used because we have 4 samples per pixel on screen
-	int current_pixel, avg_counter;
-	
-	static PT_T measured_pt = {0, 0}, set_pt = {0, 0}, prev_measured_pt = {0, 120}, prev_set_pt = {0, 120};
-	
-	if(samples_taken >= NUMBER_SAMPLES_NEEDED-1){		// Array is full, 960 values accumulated
-		for(current_pixel = 0; current_pixel < SCREEN_WIDTH; current_pixel++){
-			prev_measured_pt = measured_pt;
-			prev_set_pt = set_pt;
-			measured_pt.X = current_pixel;
-			set_pt.X = current_pixel;
-			if(current_pixel > 0){
-			for(avg_counter = 0; avg_counter<4; avg_counter++){											// Averages 4 values together
-				measured_avg = measured_avg + g_measured_accum[current_pixel*4+avg_counter];
-				set_avg = set_avg + g_set_accum[current_pixel*4+avg_counter];
-			}
-			
-				measured_pt.Y = 120 - measured_avg/4;
-				set_pt.Y = 120 - set_avg/4;
+// Span of a trace across one plot column, or one strip chart line. Empty if Top > Bottom.
+typedef struct {
+	uint8_t Top, Bottom;
+} UI_SPAN_T;
+
+#define UI_IN_SPAN(y, s) (((y) >= (s)->Top) && ((y) <= (s)->Bottom))
+#define UI_SPANS_OVERLAP(a, b) (((a)->Top <= (b)->Bottom) && ((b)->Top <= (a)->Bottom))
+
+static const UI_SPAN_T ui_empty_span = {1, 0};
+#if USE_STRIP_CHART
+#define UI_STRIP_TOP (20)
+#define UI_STRIP_ROWS (101)
+#endif
+
+#if (USE_CAP_AVERAGING || USE_ETS_CAPTURE) && !USE_LCD_TILES
+#error "Average and Equiv time views need USE_LCD_TILES"
+#endif
+
+/* Only one view uses the plot area at a time, so their state shares storage.
+A view starts over (UI_Clear_Plot, UI_Strip_Start) when it takes the plot back. */
+static union {
+	UI_SPAN_T Plot[SCREEN_WIDTH][2]; // Measured and set spans now on LCD
+#if USE_STRIP_CHART
+	UI_SPAN_T Strip[UI_STRIP_ROWS][2]; // Measured and set spans in each row
+#endif
+#if USE_LCD_TILES
+	uint16_t Tile[TILE_BUF_PIXELS]; // Averaged or equivalent-time plot, one band at a time
+#endif
+} ui_plot_mem;
+static int ui_plot_cleared = 0; // Plot area holds only the spans above
+static PT_T ui_plot_ul = {0, 20}, ui_plot_lr = {SCREEN_WIDTH-1, 120};
+
+/* Plot is 100 pixels high, 1 pixel per mA at 100% scale. */
+static __inline int UI_Plot_Y(int ma) {
+	int y = 120 - (ma - UI_plot_offset)*UI_plot_scale/100;
+	
+	if (y > 120)
+		return 120;
+	else if (y < 20)
+		return 20;
+	return y;
+}
+
+#if USE_CAP_AVERAGING || USE_ETS_CAPTURE
+static int UI_Tile_Y_Int16(const void * arg, int i) {
+	return UI_Plot_Y(((const int16_t *) arg)[i]);
+}
+#endif
+
+#if USE_CAP_AVERAGING
+static int UI_Tile_Y_Mean(const void * arg, int i) {
+	return UI_Plot_Y(((const int32_t *) arg)[i]>>CAP_MEAN_FRAC_BITS);
+}
+
+static int UI_Tile_Y_Set(const void * arg, int i) {
+	return UI_Plot_Y(Capture_Point((CAPTURE_BUF_T *) arg, i)->Set);
+}
+
+/* Mean of the averaged captures, with their envelope behind it and the setpoint
+of the latest capture. Composed in tiles so the plot is sent once, without
+blanking it first. */
+void UI_Draw_Average(CAPTURE_BUF_T * cap) {
+	CAP_AVG_DATA_T * d = g_cap_avg.Data;
+	
+	Tile_Begin(&ui_plot_ul, &ui_plot_lr, &pc_black, ui_plot_mem.Tile, TILE_BUF_PIXELS);
+	if (g_cap_avg.Envelope) {
+		Tile_Add_Trace(CAPTURE_DEPTH, SCREEN_WIDTH, CAPTURE_DEPTH, UI_Tile_Y_Int16, d->Min, &pc_dark_gray);
+		Tile_Add_Trace(CAPTURE_DEPTH, SCREEN_WIDTH, CAPTURE_DEPTH, UI_Tile_Y_Int16, d->Max, &pc_dark_gray);
+	}
+	Tile_Add_Trace(CAPTURE_DEPTH, SCREEN_WIDTH, CAPTURE_DEPTH, UI_Tile_Y_Set, cap, &pc_red);
+	Tile_Add_Trace(CAPTURE_DEPTH, SCREEN_WIDTH, CAPTURE_DEPTH, UI_Tile_Y_Mean, d->Sum, &pc_light_gray);
+	Tile_Render();
+}
+#endif
+
+#if USE_ETS_CAPTURE
+static int UI_Tile_Y_ETS(const void * arg, int i) {
+	int v = ((const int16_t *) arg)[i];
+	
+	return (v == ETS_NO_SAMPLE)? -1 : UI_Plot_Y(v);
+}
+
+/* Redraw the equivalent-time waveform after each pulse, with a dark line at the 
+flash edge. Points not sampled yet are skipped. */
+void UI_Draw_ETS(void) {
+	static uint32_t prev_pulses = 0;
+	PT_T p1, p2;
+	
+	if (g_ets.Pulses == prev_pulses)
+		return;
+	prev_pulses = g_ets.Pulses;
+	Tile_Begin(&ui_plot_ul, &ui_plot_lr, &pc_black, ui_plot_mem.Tile, TILE_BUF_PIXELS);
+	p1.X = p2.X = ETS_PRE_PERIODS*ETS_PHASES*SCREEN_WIDTH/ETS_POINTS;
+	p1.Y = 20;
+	p2.Y = 120;
+	Tile_Add_Rect(&p1, &p2, &pc_dark_gray);
+	Tile_Add_Trace(ETS_POINTS, SCREEN_WIDTH, ETS_POINTS, UI_Tile_Y_ETS, g_ets.Wave, &pc_green);
+	Tile_Render();
+}
+#endif
+
+/* Get the part of a capture shown in one pixel column. pos and step are in 
+1/256 points. When zoomed in, values are interpolated between points, and when
+a column covers several points they are combined. Returns 0 past the end. */
+static int UI_Plot_Column(CAPTURE_BUF_T * cap, int pos, int step, CAPTURE_POINT_T * c) {
+	int i, n, end, f, sum, sum_set;
+	CAPTURE_POINT_T * a, * b;
+	
+	i = pos >> 8;
+	if (i >= CAPTURE_DEPTH)
+		return 0;
+	a = Capture_Point(cap, i);
+	if (step <= 256) {
+		f = pos & 0xff;
+		b = (i+1 < CAPTURE_DEPTH)? Capture_Point(cap, i+1) : a;
+		c->Min = a->Min + (((b->Min - a->Min)*f) >> 8);
+		c->Max = a->Max + (((b->Max - a->Max)*f) >> 8);
+		c->Mean = a->Mean + (((b->Mean - a->Mean)*f) >> 8);
+		c->Set = a->Set + (((b->Set - a->Set)*f) >> 8);
+		return 1;
+	}
+	end = (pos + step) >> 8;
+	if (end > CAPTURE_DEPTH)
+		end = CAPTURE_DEPTH;
+	*c = *a;
+	sum = a->Mean;
+	sum_set = a->Set;
+	for (n=1, i++; i<end; i++, n++) {
+		b = Capture_Point(cap, i);
+		if (b->Min < c->Min)
+			c->Min = b->Min;
+		if (b->Max > c->Max)
+			c->Max = b->Max;
+		sum += b->Mean;
+		sum_set += b->Set;
+	}
+	c->Mean = sum/n;
+	c->Set = sum_set/n;
+	return 1;
+}
 
-				measured_avg = 0;
-				set_avg = 0;
+/* Fill pixels a to b of plot column n, or of frame memory row n if horiz. */
+static void UI_Fill_Span(int n, int a, int b, int horiz, const PCOLOR_T * color) {
+	PT_T p1, p2;
+	
+	if (horiz) {
+		p1.X = a;
+		p2.X = b;
+		p1.Y = p2.Y = n;
+	} else {
+		p1.X = p2.X = n;
+		p1.Y = a;
+		p2.Y = b;
+	}
+	LCD_Fill_Rectangle_PC(&p1, &p2, color);
+}
 
-				LCD_Draw_Line(&prev_measured_pt, &measured_pt, &light_gray);
-				LCD_Draw_Line(&prev_set_pt, &set_pt, &red);
+/* Bring one column (or row) from its old measured and set spans in old[] to the
+new ones: erase pixels which are in neither new span, then draw the changed 
+spans. Set is drawn over measured. */
+static void UI_Update_Spans(UI_SPAN_T * old, int n, int horiz, const UI_SPAN_T * m, const UI_SPAN_T * set) {
+	UI_SPAN_T * old_m = &old[0], * old_set = &old[1];
+	int y, y_min, y_max, run = -1, draw_m, draw_set;
+	
+	draw_m = (m->Top != old_m->Top) || (m->Bottom != old_m->Bottom);
+	draw_set = (set->Top != old_set->Top) || (set->Bottom != old_set->Bottom);
+	if (!draw_m && !draw_set)
+		return;
+	draw_set = draw_set || (draw_m && UI_SPANS_OVERLAP(m, set));
+	draw_m = draw_m || (draw_set && UI_SPANS_OVERLAP(old_set, m)); // Old setpoint pixels covered m
+	
+	y_min = UINT8_MAX;
+	y_max = 0;
+	if (old_m->Top <= old_m->Bottom) {
+		y_min = old_m->Top;
+		y_max = old_m->Bottom;
+	}
+	if (old_set->Top <= old_set->Bottom) {
+		y_min = MIN(y_min, old_set->Top);
+		y_max = MAX(y_max, old_set->Bottom);
+	}
+	for (y = y_min; y <= y_max + 1; y++) { // Erase runs of old pixels not covered now
+		if ((y <= y_max) && (UI_IN_SPAN(y, old_m) || UI_IN_SPAN(y, old_set))
+			&& !UI_IN_SPAN(y, m) && !UI_IN_SPAN(y, set)) {
+			if (run < 0)
+				run = y;
+		} else if (run >= 0) {
+			UI_Fill_Span(n, run, y-1, horiz, &pc_black);
+			run = -1;
 		}
 	}
-		samples_taken = SAMPLE_OFFSET;
+	if (draw_m && (m->Top <= m->Bottom))
+		UI_Fill_Span(n, m->Top, m->Bottom, horiz, &pc_light_gray);
+	if (draw_set && (set->Top <= set->Bottom))
+		UI_Fill_Span(n, set->Top, set->Bottom, horiz, &pc_red);
+	*old_m = *m;
+	*old_set = *set;
+}
+
+/* Forget what the plot shows after it has been drawn some other way, and erase it. */
+static void UI_Clear_Plot(void) {
+	int x;
 	
-		PT_T a = {0,20};
-		PT_T b = {240,120};
-		LCD_Fill_Rectangle(&a,&b, &black);
+	LCD_Fill_Rectangle(&ui_plot_ul, &ui_plot_lr, &black);
+	for (x = 0; x < SCREEN_WIDTH; x++) {
+		ui_plot_mem.Plot[x][0] = ui_empty_span;
+		ui_plot_mem.Plot[x][1] = ui_empty_span;
 	}
+	ui_plot_cleared = 1;
+}
+
+static __inline void UI_Set_Span(UI_SPAN_T * s, int y1, int y2) {
+	s->Top = MIN(y1, y2);
+	s->Bottom = MAX(y1, y2);
 }
+
+/* Trace polylines of the plot and strip chart (static to spare the screen 
+thread's stack), and the spans they produce for each column or line, collected
+for UI_Update_Spans. */
+static LCD_POLYLINE_T ui_pl_m, ui_pl_set;
+static UI_SPAN_T ui_col_m, ui_col_set;
+static int ui_pl_end; // Last point added to measured trace
+
+static void UI_Col_Span_M(int x, int top, int bottom, const PCOLOR_T * color) {
+	UI_Set_Span(&ui_col_m, top, bottom);
+}
+
+static void UI_Col_Span_Set(int x, int top, int bottom, const PCOLOR_T * color) {
+	UI_Set_Span(&ui_col_set, top, bottom);
+}
+
+static void UI_Trace_Start(PT_T * ul, PT_T * lr) {
+	LCD_Polyline_Start_PC(&ui_pl_m, ul, lr, &pc_light_gray);
+	ui_pl_m.Draw_Span = UI_Col_Span_M;
+	LCD_Polyline_Start_PC(&ui_pl_set, ul, lr, &pc_red);
+	ui_pl_set.Draw_Span = UI_Col_Span_Set;
+}
+
+/* Add column (or line) x to the traces, given the screen positions of the point's
+max, min and mean measured current and its setpoint. With peak detect, the 
+measured trace visits the max and min, nearer one first, else the mean. Adding
+x completes the spans of x-1, so clear ui_col_m and ui_col_set first. */
+static void UI_Trace_Add(int x, int hi, int lo, int mean, int set) {
+	int y;
+	
+	if (UI_plot_peak) {
+		if ((ui_pl_m.NumPoints > 0) && (abs(ui_pl_end - lo) < abs(ui_pl_end - hi))) {
+			y = lo;
+			lo = hi;
+			hi = y;
+		}
+		LCD_Polyline_Add(&ui_pl_m, x, hi);
+		LCD_Polyline_Add(&ui_pl_m, x, lo);
+		ui_pl_end = lo;
+	} else {
+		LCD_Polyline_Add(&ui_pl_m, x, mean);
+	}
+	LCD_Polyline_Add(&ui_pl_set, x, set);
+}
+
+#if USE_STRIP_CHART
+/* The strip chart is a waterfall. It uses the plot area as the controller's 
+vertical scrolling area, one frame memory row (line) per point, with the oldest
+line at the top and the newest at the bottom. Current increases to the right, 
+with the plot's scale and offset. A new line is drawn over the oldest one, then 
+the scroll start moves past it so it appears at the bottom, and the other lines
+move up. Nothing else is redrawn. The traces are polylines along the lines, so 
+each line is drawn when the next point arrives. */
+static int ui_strip_running = 0;
+static int ui_strip_oldest; // Row shown first in scrolling area
+static int ui_strip_n; // Points added since start
+
+/* Same scale and offset as the plot, along the rows. */
+static __inline int UI_Strip_X(int ma) {
+	int x = (ma - UI_plot_offset)*UI_plot_scale/100;
+	
+	if (x < 0)
+		return 0;
+	else if (x > SCREEN_WIDTH-1)
+		return SCREEN_WIDTH-1;
+	return x;
+}
+
+static void UI_Strip_Start(void) {
+	PT_T ul = {0, 0}, lr = {INT32_MAX, SCREEN_WIDTH-1}; // Point number, column
+	int i;
+	
+	UI_Clear_Plot();
+	for (i = 0; i < UI_STRIP_ROWS; i++) {
+		ui_plot_mem.Strip[i][0] = ui_empty_span;
+		ui_plot_mem.Strip[i][1] = ui_empty_span;
+	}
+	ui_strip_oldest = 0;
+	ui_strip_n = 0;
+	UI_Trace_Start(&ul, &lr);
+	LCD_Set_Scroll_Area(UI_STRIP_TOP, UI_STRIP_ROWS);
+	LCD_Set_Scroll_Start(UI_STRIP_TOP);
+	ui_strip_running = 1;
+}
+
+/* Back to unscrolled display. Frame memory rows are out of order, so the plot
+is cleared before it is next drawn. */
+static void UI_Strip_Stop(void) {
+	LCD_Set_Scroll_Start(UI_STRIP_TOP);
+	ui_strip_running = 0;
+	ui_plot_cleared = 0;
+}
+
+/* Add one point, which completes the line of the previous one. */
+static void UI_Strip_Add(CAPTURE_POINT_T * p) {
+	ui_col_m = ui_col_set = ui_empty_span;
+	UI_Trace_Add(ui_strip_n, UI_Strip_X(p->Max), UI_Strip_X(p->Min), 
+		UI_Strip_X(p->Mean >> CAP_MEAN_FRAC_BITS), UI_Strip_X(p->Set));
+	if (ui_strip_n++ == 0)
+		return;
+	UI_Update_Spans(ui_plot_mem.Strip[ui_strip_oldest], UI_STRIP_TOP + ui_strip_oldest, 1, &ui_col_m, &ui_col_set);
+	if (++ui_strip_oldest >= UI_STRIP_ROWS)
+		ui_strip_oldest = 0;
+	LCD_Set_Scroll_Start(UI_STRIP_TOP + ui_strip_oldest);
+}
+
+/* Draw all points queued since the last screen update. */
+static void UI_Draw_Strip(void) {
+	CAPTURE_POINT_T p;
+	uint32_t bus_writes;
+	
+	if (!ui_strip_running)
+		UI_Strip_Start();
+	while (1) {
+		bus_writes = g_lcd_bus_writes;
+		if (!Strip_Get(&p))
+			break;
+		UI_Strip_Add(&p);
+		UI_strip_bus_writes = g_lcd_bus_writes - bus_writes;
+	}
+}
+#endif
+
+/* Each trace is a polyline, which gives one vertical span per column. Spans are
+compared with those on the LCD, so only columns which changed since the last 
+capture are sent. */
+void UI_Draw_Current(void){
+	int x, step, pan, max_pan;
+	uint32_t bus_writes = g_lcd_bus_writes;
+	CAPTURE_BUF_T * cap;
+	CAPTURE_POINT_T col, * p = &col;
+	
+#if USE_STRIP_CHART
+	if (g_strip_enable) {
+		UI_Draw_Strip();
+		return;
+	}
+	if (ui_strip_running)
+		UI_Strip_Stop();
+#endif
+#if USE_ETS_CAPTURE
+	if (g_ets_enable) {
+		UI_Draw_ETS();
+		ui_plot_cleared = 0;
+		return;
+	}
+#endif
+	cap = Capture_Acquire();
+#if USE_CAP_AVERAGING
+	if ((cap != NULL) && (g_cap_avg.Count > 1)) {
+		if (Capture_Average_Update()) {
+			UI_Draw_Average(cap);
+			Capture_Average_Release();
+		}
+		Capture_Release(cap);
+		ui_plot_cleared = 0;
+		return;
+	}
+	if (g_cap_avg.Ready && (g_cap_avg.Count <= 1))
+		Capture_Average_Release(); // Turned off with a sum pending: let the ISR free its buffer
+#endif
+	if(cap != NULL){		// Triggered capture of CAPTURE_DEPTH points is complete
+		if (!ui_plot_cleared)
+			UI_Clear_Plot();
+		step = UI_plot_spp8*(256/8)/cap->Decimation;
+		max_pan = CAPTURE_DEPTH - SCREEN_WIDTH*step/256;
+		pan = UI_plot_pan;
+		if (pan > max_pan)
+			pan = (max_pan > 0)? max_pan : 0;
+		UI_Trace_Start(&ui_plot_ul, &ui_plot_lr);
+		for (x = 0; x < SCREEN_WIDTH; x++) {
+			if (!UI_Plot_Column(cap, pan*256 + x*step, step, p)) // Past end of capture
+				break;
+			ui_col_m = ui_col_set = ui_empty_span;
+			UI_Trace_Add(x, UI_Plot_Y(p->Max), UI_Plot_Y(p->Min), 
+				UI_Plot_Y(p->Mean >> CAP_MEAN_FRAC_BITS), UI_Plot_Y(p->Set));
+			if (x > 0)
+				UI_Update_Spans(ui_plot_mem.Plot[x-1], x-1, 0, &ui_col_m, &ui_col_set);
+		}
+		ui_col_m = ui_col_set = ui_empty_span;
+		LCD_Polyline_End(&ui_pl_m);
+		LCD_Polyline_End(&ui_pl_set);
+		if (x > 0)
+			UI_Update_Spans(ui_plot_mem.Plot[x-1], x-1, 0, &ui_col_m, &ui_col_set);
+		for (; x < SCREEN_WIDTH; x++)
+			UI_Update_Spans(ui_plot_mem.Plot[x], x, 0, &ui_empty_span, &ui_empty_span);
+		Capture_Release(cap);
+		UI_plot_bus_writes = g_lcd_bus_writes - bus_writes;
+	}
+}
+#if USE_CTL_TIMING
+/* Show ISR duration histogram on last field row, one digit per bin (0-9, 
+scaled to fullest bin). Leftmost bin is 0 to 15 cycles, each later bin covers
+twice the range: 16-31, 32-63, ... */
+void UI_Draw_Timing_Page(void) {
+	char buffer[CTL_TIMING_HIST_BINS+5];
+	uint32_t max=1, n;
+	int i;
+	
+	Ctl_Timing_Update_Summary();
+	for (i=0; i<CTL_TIMING_HIST_BINS; i++) {
+		if (g_ctl_timing.ISR_Duration.Hist[i] > max)
+			max = g_ctl_timing.ISR_Duration.Hist[i];
+	}
+	strcpy(buffer, "Hst ");
+	for (i=0; i<CTL_TIMING_HIST_BINS; i++) {
+		n = g_ctl_timing.ISR_Duration.Hist[i];
+		buffer[4+i] = (n == 0)? '.' : '0' + (int)(((uint64_t) n*9 + max-1)/max);
+	}
+	buffer[4+CTL_TIMING_HIST_BINS] = '\0';
+	LCD_Text_Set_Colors(&light_gray, &black);
+	LCD_Text_PrintStr_RC(UI_LAST_FIELD_ROW, 0, buffer);
+}
+#endif
+
+#if USE_STRIP_CHART
+/* Label the waterfall on the free field rows: which end is newest, the time it
+spans, and the current at its left and right edges. Redrawn when they change. */
+void UI_Draw_Strip_Page(void) {
+	static int prev_ms = -1, prev_lo, prev_hi;
+	char buffer[24];
+	int ms, lo, hi;
+	
+	ms = UI_STRIP_ROWS*g_strip_decimation/(CTL_SAMPLE_FREQ_HZ/1000);
+	lo = UI_plot_offset;
+	hi = UI_plot_offset + (SCREEN_WIDTH-1)*100/UI_plot_scale;
+	if (!UI_page_changed && (ms == prev_ms) && (lo == prev_lo) && (hi == prev_hi))
+		return;
+	prev_ms = ms;
+	prev_lo = lo;
+	prev_hi = hi;
+	LCD_Text_Set_Colors(&light_gray, &black);
+	LCD_Text_PrintStr_RC(UI_LAST_FIELD_ROW-2, 0, "Newest at bottom");
+	snprintf(buffer, sizeof(buffer), "Height %6d ms", ms);
+	LCD_Text_PrintStr_RC(UI_LAST_FIELD_ROW-1, 0, buffer);
+	snprintf(buffer, sizeof(buffer), "mA %5d to %5d", lo, hi);
+	LCD_Text_PrintStr_RC(UI_LAST_FIELD_ROW, 0, buffer);
+}
+#endif
+
+#if USE_FLASH_METRICS
+static void UI_Print_FM_Stat(int row, char * label, FM_STAT_T * s) {
+	char buffer[24];
+	
+	snprintf(buffer, sizeof(buffer), "%-5s%5d%5d%5d", label, s->Min, s->Mean, s->Max);
+	LCD_Text_PrintStr_RC(row, 0, buffer);
+}
+
+/* Min, mean and max of metrics over recent flash pulses. */
+void UI_Draw_Flash_Page(void) {
+	char buffer[24];
+	FM_SUMMARY_T * s = &g_fm_summary;
+	
+	Flash_Metrics_Update_Summary();
+	LCD_Text_Set_Colors(&light_gray, &black);
+	snprintf(buffer, sizeof(buffer), "%d/%-3d  min mean  max", s->NumPulses, FM_RING_SIZE);
+	LCD_Text_PrintStr_RC(UI_FIRST_FIELD_ROW, 0, buffer);
+	UI_Print_FM_Stat(UI_FIRST_FIELD_ROW+1, "Rise", &s->Rise);
+	UI_Print_FM_Stat(UI_FIRST_FIELD_ROW+2, "Ovs%", &s->Overshoot);
+	UI_Print_FM_Stat(UI_FIRST_FIELD_ROW+3, "Sett", &s->Settle);
+	UI_Print_FM_Stat(UI_FIRST_FIELD_ROW+4, "SSE", &s->SSError);
+	UI_Print_FM_Stat(UI_FIRST_FIELD_ROW+5, "mAms", &s->Charge);
+	LCD_Text_PrintStr_RC(UI_FIRST_FIELD_ROW+6, 0, "Rise,Sett us SSE uA");
+}
+#endif
+
 void UI_Draw_Screen(int first_time) { // Called by Thread_Update_Screen
 	static uint32_t counter=0;
 	char buffer[32];
+	UI_PAGE_T * page = &Pages[UI_cur_page];
+	PT_T ul, lr;
 	
-	if (first_time) {
-		UI_Update_Field_Values(Fields, UI_NUM_FIELDS);
+	if (UI_page_changed) { // Erase field rows of previous page
+		ul.X = 0;
+		ul.Y = ROW_TO_Y(UI_FIRST_FIELD_ROW);
+		lr.X = LCD_WIDTH-1;
+		lr.Y = ROW_TO_Y(UI_LAST_FIELD_ROW+1)-1;
+		LCD_Fill_Rectangle(&ul, &lr, &black);
+	}
+	if (first_time || UI_page_changed) {
+		UI_Update_Field_Values(page->Fields, page->NumFields);
 	}
 	
 	UI_Draw_Current();
 	
-	UI_Update_Volatile_Field_Values(Fields);
-	UI_Draw_Fields(Fields, UI_NUM_FIELDS);
+	UI_Update_Volatile_Field_Values(page->Fields, page->NumFields);
+	UI_Draw_Fields(page->Fields, page->NumFields);
+	if (page->Draw != NULL)
+		(*page->Draw)();
 	UI_Draw_Slider(&Slider);
 	
 	LCD_Text_Set_Colors(&white, &black);
-	if (first_time) {
-			LCD_Text_PrintStr_RC(0, 6, "screen redraws");
+	if (first_time || UI_page_changed) {
+			LCD_Text_PrintStr_RC(0, UI_PAGE_NAME_COL, page->Name);
+			UI_page_changed = 0;
 	}
 	sprintf(buffer, "%5d", counter++);
 	LCD_Text_PrintStr_RC(0, 0, buffer);
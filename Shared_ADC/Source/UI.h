@@ -21,6 +21,13 @@ typedef struct sUI_FIELD_T {
 	void (*Handler)(UI_FIELD_T * fld, int v); // Handler function to change value based on slider pos v
 } UI_FIELD_T ;
 
+typedef struct {
+	char * Name;
+	UI_FIELD_T * Fields; 
+	int NumFields;
+	void (*Draw)(void); // Optional page-specific drawing, called after fields are drawn
+} UI_PAGE_T;
+
 typedef struct  {
 	int Val; // Is 0 when touched at horizontal middle 
 	PT_T UL, LR;
@@ -29,7 +36,13 @@ typedef struct  {
 } UI_SLIDER_T;
 
 #define UI_NUM_FIELDS (sizeof(Fields)/sizeof(UI_FIELD_T))
+#define UI_NUM_PAGES (sizeof(Pages)/sizeof(UI_PAGE_T))
 #define UI_SLIDER (100)
+#define UI_PAGE_SELECT (101)
+
+#define UI_PAGE_NAME_COL (6) // Page name shown on row 0. Touch it to change pages.
+#define UI_FIRST_FIELD_ROW (7)
+#define UI_LAST_FIELD_ROW (14)
 
 #define UI_SLIDER_HEIGHT 		(30)
 #define UI_SLIDER_WIDTH 		(LCD_WIDTH)
@@ -0,0 +1,333 @@
+#include <stdint.h>
+#include <stddef.h>
+
+#include "capture.h"
+
+CAP_TRIGGER_T g_cap_trigger = {CAP_SRC_SET, CAP_EDGE_RISING, CAP_DEF_LEVEL_MA, 
+	CAP_DEF_HYST_MA, CAP_DEF_PRETRIGGER, CAP_MODE_NORMAL};
+volatile int g_cap_state = CAP_NO_BUFFER;
+volatile int g_cap_decimation = CAP_DEF_DECIMATION;
+
+static CAPTURE_BUF_T cap_buf[CAP_NUM_BUFS];
+static volatile uint8_t cap_owner[CAP_NUM_BUFS]; // CAP_BUF_OWNER_E
+static volatile int cap_arm_request = 0; // Set by thread to re-arm SINGLE mode
+
+// Used only by ISR
+static CAPTURE_BUF_T * cap_wbuf = NULL; // buffer being filled
+static int cap_wr = 0; // ring index for next point
+static int cap_count; // points since start in FILLING and ARMED, since trigger in TRIGGERED
+static int cap_pre; // pre-trigger depth in points for capture in progress
+static int cap_decimation = CAP_DEF_DECIMATION; // samples per point for capture in progress
+static int cap_ready_to_trigger; // signal has been beyond hysteresis band
+static uint32_t cap_seq = 0;
+static int cap_n; // samples in point in progress...
+static int cap_min, cap_max, cap_sum, cap_sum_set; // ...and their statistics
+
+#if USE_CAP_AVERAGING
+typedef char CAP_AVG_DATA_FITS[(sizeof(CAP_AVG_DATA_T) <= sizeof(cap_buf[0].Points))? 1 : -1];
+
+CAP_AVG_T g_cap_avg = {1, 0, 0, 0, (CAP_AVG_DATA_T *) cap_buf[CAP_AVG_BUF].Points};
+static volatile int cap_avg_restart = 0; // Set by thread when Count changes
+static int cap_avg_on; // ISR: capture in progress is being summed
+#endif
+
+static __inline int16_t Clamp_Int16(int v) {
+	if (v > INT16_MAX)
+		return INT16_MAX;
+	else if (v < INT16_MIN)
+		return INT16_MIN;
+	return (int16_t) v;
+}
+
+/* Check trigger condition for new sample of trigger source. */
+static __inline int Capture_Triggered(int v) {
+	CAP_TRIGGER_T * t = &g_cap_trigger;
+	
+	if (t->Edge == CAP_EDGE_RISING) {
+		if (v < t->Level - t->Hysteresis)
+			cap_ready_to_trigger = 1;
+		else if (cap_ready_to_trigger && (v >= t->Level))
+			return 1;
+	} else {
+		if (v > t->Level + t->Hysteresis)
+			cap_ready_to_trigger = 1;
+		else if (cap_ready_to_trigger && (v <= t->Level))
+			return 1;
+	}
+	return 0;
+}
+
+#if USE_CAP_AVERAGING
+/* Add point mean v to the accumulator at index i, which gets one point per capture. */
+static __inline void Capture_Average_Add(int i, int v) {
+	CAP_AVG_DATA_T * d = g_cap_avg.Data;
+	
+	d->Sum[i] += v;
+	v >>= CAP_MEAN_FRAC_BITS;
+	if ((g_cap_avg.Done == 0) || (v < d->Min[i]))
+		d->Min[i] = v;
+	if ((g_cap_avg.Done == 0) || (v > d->Max[i]))
+		d->Max[i] = v;
+}
+
+/* Reserve buffer CAP_AVG_BUF for the accumulator while averaging is on, once
+the thread is done with it, and free it again when averaging is turned off. */
+static void Capture_Average_Reserve(void) {
+	if (g_cap_avg.Count > 1) {
+		if (cap_owner[CAP_AVG_BUF] == CAP_BUF_FREE) {
+			cap_owner[CAP_AVG_BUF] = CAP_BUF_AVERAGE;
+			cap_avg_restart = 1; // Thread clears it
+		}
+	} else if ((cap_owner[CAP_AVG_BUF] == CAP_BUF_AVERAGE) && !g_cap_avg.Ready) {
+		cap_owner[CAP_AVG_BUF] = CAP_BUF_FREE;
+	}
+}
+#endif
+
+/* Write the point in progress to the ring. */
+static void Capture_End_Point(CAPTURE_BUF_T * b) {
+	CAPTURE_POINT_T * p = &b->Points[cap_wr];
+	
+	p->Min = Clamp_Int16(cap_min);
+	p->Max = Clamp_Int16(cap_max);
+	p->Mean = Clamp_Int16((cap_sum*(1<<CAP_MEAN_FRAC_BITS) + cap_n/2)/cap_n);
+	p->Set = Clamp_Int16(cap_sum_set/cap_n);
+	cap_n = 0;
+	if (++cap_wr >= CAPTURE_DEPTH)
+		cap_wr = 0;
+	cap_count++;
+#if USE_CAP_AVERAGING
+	// Add this point, and while there are any left also pre-trigger point cap_count-1
+	if ((g_cap_state == CAP_TRIGGERED) && cap_avg_on) {
+		Capture_Average_Add(cap_pre + cap_count - 1, p->Mean);
+		if (cap_count <= cap_pre)
+			Capture_Average_Add(cap_count - 1, Capture_Point(b, cap_count - 1)->Mean);
+	}
+#endif
+}
+
+/* Claim a free buffer and start a capture in it. Returns 0 if none is free. */
+static int Capture_Start(void) {
+	int i, pre, d;
+	
+#if USE_CAP_AVERAGING
+	Capture_Average_Reserve();
+#endif
+	for (i=0; i<CAP_NUM_BUFS; i++) {
+		if (cap_owner[i] == CAP_BUF_FREE) {
+			cap_owner[i] = CAP_BUF_FILLING;
+			cap_wbuf = &cap_buf[i];
+			d = g_cap_decimation;
+			if (d < 1)
+				d = 1;
+			else if (d > CAP_MAX_DECIMATION)
+				d = CAP_MAX_DECIMATION;
+#if USE_CAP_AVERAGING
+			if (d != cap_decimation) // Don't average captures with different timebases
+				cap_avg_restart = 1;
+#endif
+			cap_decimation = d;
+			cap_wbuf->Decimation = d;
+			pre = (g_cap_trigger.PreTrigger + d-1)/d;
+			if (pre > CAPTURE_DEPTH-1)
+				pre = CAPTURE_DEPTH-1;
+			else if (pre < 0)
+				pre = 0;
+#if USE_CAP_AVERAGING
+			if ((g_cap_avg.Count > 1) && (pre > CAPTURE_DEPTH/2))
+				pre = CAPTURE_DEPTH/2;
+			if (cap_avg_restart && !g_cap_avg.Ready) { // Thread clears partial sum
+				cap_avg_restart = 0;
+				g_cap_avg.Done = 0;
+				g_cap_avg.Ready = 1;
+			}
+#endif
+			cap_pre = pre;
+			cap_count = 0;
+			cap_wr = 0;
+			cap_n = 0;
+			cap_arm_request = 0;
+			g_cap_state = CAP_FILLING;
+			return 1;
+		}
+	}
+	cap_wbuf = NULL;
+	g_cap_state = CAP_NO_BUFFER;
+	return 0;
+}
+
+/* Called by Control_HBLED every sample. */
+void Capture_Sample(int measured, int set) {
+	CAPTURE_BUF_T * b;
+	
+	if (g_cap_state == CAP_STOPPED) {
+		if (!cap_arm_request)
+			return;
+		cap_arm_request = 0;
+		g_cap_state = CAP_NO_BUFFER;
+	}
+	if (g_cap_state == CAP_NO_BUFFER) {
+		if (!Capture_Start())
+			return; // Try again next sample
+	}
+	
+	b = cap_wbuf;
+	switch (g_cap_state) {
+		case CAP_FILLING:
+			if (cap_count < cap_pre)
+				break;
+			g_cap_state = CAP_ARMED;
+			cap_ready_to_trigger = 0;
+			// fall through to check this sample
+		case CAP_ARMED:
+			if (Capture_Triggered((g_cap_trigger.Source == CAP_SRC_SET)? set : measured)
+				|| ((g_cap_trigger.Mode == CAP_MODE_AUTO) 
+					&& (cap_count >= cap_pre + CAP_AUTO_TIMEOUT/cap_decimation))) {
+				if (cap_n > 0)
+					Capture_End_Point(b); // Trigger sample starts a new point
+				b->Start = cap_wr - cap_pre;
+				if (b->Start < 0)
+					b->Start += CAPTURE_DEPTH;
+				b->Trigger = cap_pre;
+				cap_count = 0;
+				g_cap_state = CAP_TRIGGERED;
+#if USE_CAP_AVERAGING
+				cap_avg_on = (g_cap_avg.Count > 1) && !g_cap_avg.Ready && !cap_avg_restart
+					&& (cap_pre <= CAPTURE_DEPTH/2) && (cap_owner[CAP_AVG_BUF] == CAP_BUF_AVERAGE);
+#endif
+			}
+			break;
+		default:
+			break;
+	}
+	
+	// Decimate
+	if (cap_n == 0) {
+		cap_min = cap_max = measured;
+		cap_sum = cap_sum_set = 0;
+	} else if (measured < cap_min) {
+		cap_min = measured;
+	} else if (measured > cap_max) {
+		cap_max = measured;
+	}
+	cap_sum += measured;
+	cap_sum_set += set;
+	if (++cap_n < cap_decimation)
+		return;
+	Capture_End_Point(b);
+	
+	if ((g_cap_state == CAP_TRIGGERED) && (cap_count >= CAPTURE_DEPTH - cap_pre)) {
+#if USE_CAP_AVERAGING
+		if (cap_avg_on && (++g_cap_avg.Done >= g_cap_avg.Count))
+			g_cap_avg.Ready = 1;
+#endif
+		b->Seq = cap_seq++;
+		cap_owner[b - cap_buf] = CAP_BUF_READY; // Hand over to display
+		cap_wbuf = NULL;
+		if (g_cap_trigger.Mode == CAP_MODE_SINGLE)
+			g_cap_state = CAP_STOPPED;
+		else
+			Capture_Start();
+	}
+}
+
+/* Take the newest completed capture for display, or return NULL if none is ready.
+Older completed captures are discarded. Called from a thread. */
+CAPTURE_BUF_T * Capture_Acquire(void) {
+	int i, newest = -1;
+	
+	for (i=0; i<CAP_NUM_BUFS; i++) {
+		if (cap_owner[i] == CAP_BUF_READY) {
+			if (newest < 0) {
+				newest = i;
+			} else if ((int32_t)(cap_buf[i].Seq - cap_buf[newest].Seq) > 0) {
+				cap_owner[newest] = CAP_BUF_FREE;
+				newest = i;
+			} else {
+				cap_owner[i] = CAP_BUF_FREE;
+			}
+		}
+	}
+	if (newest < 0)
+		return NULL;
+	cap_owner[newest] = CAP_BUF_DISPLAY;
+	return &cap_buf[newest];
+}
+
+/* Give a displayed capture back to the ISR. */
+void Capture_Release(CAPTURE_BUF_T * b) {
+	cap_owner[b - cap_buf] = CAP_BUF_FREE;
+}
+
+/* Touching the slider re-arms a stopped capture. */
+void Capture_Arm_Handler(UI_FIELD_T * fld, int v) {
+	cap_arm_request = 1;
+}
+
+/* Adjust trigger settings, keeping each within its range. */
+void Capture_Config_Handler(UI_FIELD_T * fld, int v) {
+	int n, max = INT16_MAX;
+	
+	if (fld->Val == NULL)
+		return;
+	if ((fld->Val == &g_cap_trigger.Source) || (fld->Val == &g_cap_trigger.Edge))
+		max = 1;
+	else if (fld->Val == &g_cap_trigger.Mode)
+		max = CAP_MODE_AUTO;
+	else if (fld->Val == &g_cap_trigger.PreTrigger)
+		max = (CAPTURE_DEPTH-1)*CAP_MAX_DECIMATION;
+	n = *fld->Val + v/16;
+	if (n < 0)
+		n = 0;
+	else if (n > max)
+		n = max;
+	*fld->Val = n;
+}
+
+#if USE_CAP_AVERAGING
+/* Called by the display thread. Once the ISR has summed Count captures, 
+replaces the sum with their mean. Returns 1 when g_cap_avg.Data holds a new
+mean and envelope; the caller then draws them and calls Capture_Average_Release. */
+int Capture_Average_Update(void) {
+	int i, n;
+	
+	if (!g_cap_avg.Ready)
+		return 0;
+	n = g_cap_avg.Done;
+	if (n == 0) { // Restarted
+		Capture_Average_Release();
+		return 0;
+	}
+	for (i=0; i<CAPTURE_DEPTH; i++)
+		g_cap_avg.Data->Sum[i] /= n;
+	return 1;
+}
+
+/* Clear the sum and hand it back to the ISR. The envelope starts over with 
+the next capture summed. */
+void Capture_Average_Release(void) {
+	int i;
+	
+	for (i=0; i<CAPTURE_DEPTH; i++)
+		g_cap_avg.Data->Sum[i] = 0;
+	g_cap_avg.Done = 0;
+	g_cap_avg.Ready = 0; // Hand sum back to ISR
+}
+
+/* Set number of captures to average (1 is off), or turn the envelope on or off. */
+void Capture_Average_Handler(UI_FIELD_T * fld, int v) {
+	int n;
+	
+	if (fld->Val == &g_cap_avg.Envelope) {
+		g_cap_avg.Envelope = (v > 0)? 1 : 0;
+		return;
+	}
+	n = g_cap_avg.Count + v/16;
+	if (n < 1)
+		n = 1;
+	else if (n > CAP_AVG_MAX_COUNT)
+		n = CAP_AVG_MAX_COUNT;
+	g_cap_avg.Count = n;
+	cap_avg_restart = 1;
+}
+#endif
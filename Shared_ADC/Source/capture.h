@@ -0,0 +1,146 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdint.h>
+#include "UI.h"
+
+/* Triggered capture of measured and set current for the plot, like an 
+oscilloscope. Samples are decimated as they arrive into points of 
+g_cap_decimation samples, about one per pixel column, keeping the minimum, maximum
+and mean of the measured current and the mean setpoint. Points are written 
+continuously into a ring. When the trigger condition occurs, the point in 
+progress is ended early so that the trigger sample starts a point, and capture
+continues until the ring holds the requested pre-trigger history followed by
+the rest of the record.
+
+There are two capture buffers. The ISR fills one while the display thread 
+draws the other. Each buffer has an owner state, and each state is only left
+by the side that owns it (FREE and FILLING by the ISR, READY and DISPLAY by 
+the thread), so handing a buffer over is a single store and needs no locking. */
+
+#define CAPTURE_DEPTH (240) // points per buffer
+#define CAP_DEF_DECIMATION (4) // samples per point, so the whole capture fits the screen
+#define CAP_MAX_DECIMATION (64)
+#define CAP_NUM_BUFS (2)
+#define CAP_MEAN_FRAC_BITS (4) // Mean is in 1/16 mA
+
+/* Ensemble averaging. The ISR adds the mean of each captured point into an 
+accumulator as the point is completed, and tracks its min and max (envelope),
+until Count triggered captures are summed. Pre-trigger points are added from 
+the ring one per post-trigger point, so the pre-trigger depth is limited to 
+half the capture. The display thread then divides the accumulator in place, 
+draws the mean and clears it. The ISR only touches the accumulator while Ready
+is clear, and the thread only while it is set. 
+While averaging, the last capture buffer holds the accumulator instead of 
+points, so captures are single buffered and no extra RAM is needed for it. 
+Experimental, opt-in: its code and view tiles add ~0.3 KB RAM, which doesn't
+fit alongside the waterfall. Its page is labelled "Avg (exp)", and its view
+needs USE_LCD_TILES. */
+#define USE_CAP_AVERAGING (0)
+#define CAP_AVG_MAX_COUNT (256) // Sum of 256 points of up to INT16_MAX fits int32
+
+// Trigger configuration defaults
+#define CAP_DEF_LEVEL_MA (1)
+#define CAP_DEF_HYST_MA (0)
+#define CAP_DEF_PRETRIGGER (100) // samples before trigger in each capture, rounded up to points
+#define CAP_AUTO_TIMEOUT (24000) // samples without trigger before AUTO mode captures anyway
+
+typedef enum {CAP_SRC_SET, CAP_SRC_MEASURED} CAP_SOURCE_E;
+typedef enum {CAP_EDGE_RISING, CAP_EDGE_FALLING} CAP_EDGE_E;
+typedef enum {CAP_MODE_SINGLE, CAP_MODE_NORMAL, CAP_MODE_AUTO} CAP_MODE_E;
+
+// Capture states
+typedef enum {
+	CAP_STOPPED, // SINGLE mode after a capture, until re-armed
+	CAP_FILLING, // collecting pre-trigger history
+	CAP_ARMED, // waiting for trigger
+	CAP_TRIGGERED, // collecting post-trigger points
+	CAP_NO_BUFFER // both buffers are waiting for or being displayed
+} CAP_STATE_E;
+
+// Buffer owner states. AVERAGE: holds CAP_AVG_DATA_T, owned as g_cap_avg.Ready says.
+typedef enum {CAP_BUF_FREE, CAP_BUF_FILLING, CAP_BUF_READY, CAP_BUF_DISPLAY, CAP_BUF_AVERAGE} CAP_BUF_OWNER_E;
+
+typedef struct { // ints so UI fields can edit them
+	int Source; // CAP_SOURCE_E
+	int Edge; // CAP_EDGE_E
+	int Level; // mA
+	int Hysteresis; // mA, signal must first be this far on the other side of Level
+	int PreTrigger; // samples
+	int Mode; // CAP_MODE_E
+} CAP_TRIGGER_T;
+
+typedef struct {
+	int16_t Min, Max; // mA, measured
+	int16_t Mean; // mA with CAP_MEAN_FRAC_BITS fraction bits, measured
+	int16_t Set; // mA, mean
+} CAPTURE_POINT_T;
+
+typedef struct {
+	CAPTURE_POINT_T Points[CAPTURE_DEPTH]; // ring
+	int Start; // ring index of oldest point in completed capture
+	int Trigger; // index of point starting with trigger sample
+	int Decimation; // samples per point
+	uint32_t Seq; // capture number
+} CAPTURE_BUF_T;
+
+#if USE_CAP_AVERAGING
+#define CAP_AVG_BUF (CAP_NUM_BUFS-1) // Capture buffer reserved while averaging
+
+typedef struct { // Same size as the Points of a capture buffer
+	int32_t Sum[CAPTURE_DEPTH]; // of point means, then their mean (as point Mean) until released
+	int16_t Min[CAPTURE_DEPTH], Max[CAPTURE_DEPTH]; // mA, of point means
+} CAP_AVG_DATA_T;
+
+typedef struct {
+	int Count; // captures to average, 1 is off
+	int Envelope; // also draw min and max of points over captures averaged
+	volatile int Done; // captures in Sum
+	volatile int Ready; // Set by ISR when Sum is complete (or to restart), cleared by thread
+	CAP_AVG_DATA_T * Data; // In capture buffer CAP_AVG_BUF
+} CAP_AVG_T;
+
+extern CAP_AVG_T g_cap_avg;
+#endif
+
+extern CAP_TRIGGER_T g_cap_trigger;
+extern volatile int g_cap_state; // CAP_STATE_E
+extern volatile int g_cap_decimation; // Samples per point, takes effect with next capture
+
+void Capture_Sample(int measured, int set);
+CAPTURE_BUF_T * Capture_Acquire(void);
+void Capture_Release(CAPTURE_BUF_T * b);
+void Capture_Arm_Handler(UI_FIELD_T * fld, int v);
+void Capture_Config_Handler(UI_FIELD_T * fld, int v);
+#if USE_CAP_AVERAGING
+int Capture_Average_Update(void);
+void Capture_Average_Release(void);
+void Capture_Average_Handler(UI_FIELD_T * fld, int v);
+#endif
+
+// Accessor for acquired capture. Point 0 is oldest, trigger is at b->Trigger.
+static __inline CAPTURE_POINT_T * Capture_Point(CAPTURE_BUF_T * b, int i) {
+	i += b->Start;
+	if (i >= CAPTURE_DEPTH)
+		i -= CAPTURE_DEPTH;
+	return &b->Points[i];
+}
+
+/* Per-sample view of an acquired capture, for code written against the old 
+g_measured_accum and g_set_accum arrays. Sample i (0 to Capture_Samples(b)-1)
+falls in point i/Decimation, so it reads as that point's mean. */
+#define NUMBER_SAMPLES_NEEDED (CAPTURE_DEPTH*CAP_DEF_DECIMATION) // Old array length
+
+static __inline int Capture_Samples(CAPTURE_BUF_T * b) {
+	return CAPTURE_DEPTH*b->Decimation;
+}
+
+static __inline int Capture_Measured(CAPTURE_BUF_T * b, int i) {
+	return Capture_Point(b, i/b->Decimation)->Mean >> CAP_MEAN_FRAC_BITS;
+}
+
+static __inline int Capture_Set(CAPTURE_BUF_T * b, int i) {
+	return Capture_Point(b, i/b->Decimation)->Set;
+}
+
+#endif // CAPTURE_H
@@ -1,6 +1,7 @@
 #include <MKL25Z4.H>
 #include <stdio.h>
 #include <stdint.h>
+#include <limits.h>
 #include <cmsis_os2.h>
 
 #include "gpio_defs.h"
@@ -15,8 +16,15 @@
 #include "UI.h"
 
 #include "FX.h"
+#include "ctl_timing.h"
+#include "recorder.h"
+#include "flash_metrics.h"
+#include "capture.h"
+#include "ets.h"
+#include "strip.h"
 
 volatile int32_t g_duty_cycle=5;  // global to give debugger access
+volatile FX16_16 g_duty_cycle_FX=INT_TO_FX(5); // full-resolution duty cycle, with fraction
 
 volatile int g_enable_flash=1;
 volatile int g_peak_set_current=FLASH_CURRENT_MA; // Peak flash current
@@ -28,15 +36,19 @@ volatile int time1,time2, time_took;
 volatile int g_enable_control=1;
 volatile int g_set_current=0; // Default starting LED current
 
-int g_measured_accum[NUMBER_SAMPLES_NEEDED];
-int g_set_accum[NUMBER_SAMPLES_NEEDED];
-int samples_taken = 0;
-int state = 0;
 volatile int direction;
 
 volatile int g_measured_current;
 volatile int error;
 
+volatile int g_hw_limit_trips=0; // Number of hardware current limit events
+volatile int g_led_fault=0; // Latched FAULT_* flags
+
+// Reasons the PWM pin is disconnected from TPM0
+#define PWM_CUT_HW_LIMIT (1) // until next PWM period without overcurrent
+#define PWM_CUT_FAULT (2) // until g_led_fault is cleared
+volatile int pwm_cut=0;
+
 volatile uint16_t time_remaining, diff;
 
 int32_t pGain_8 = PGAIN_8; // proportional gain numerator scaled by 2^8
@@ -74,6 +86,39 @@ SPidFX plantPID_FX = {FL_TO_FX(0), // dState
 	D_GAIN_FX  // dGain
 };
 
+SOuterFX plantOuter_FX = {{FL_TO_FX(0)}, // iDuty
+	FL_TO_FX(LIM_DUTY_CYCLE), // iMax
+	FL_TO_FX(0), // iMin
+	I_GAIN_SPLIT_FX, // iGain
+	FF_GAIN_SPLIT_FX, // ffGain
+	FF_OFFSET_SPLIT_FX // ffOffset
+};
+
+// Inner loop gain schedule for PID_FX_Split, ordered by increasing setpoint
+const CTL_GAIN_BAND_T Gain_Schedule[CTL_NUM_GAIN_BANDS] = {
+	{10, FL_TO_FX(0.5)},
+	{50, FL_TO_FX(1.0)},
+	{INT_MAX, FL_TO_FX(1.5)}
+};
+
+// Lock-free handoff between outer loop (thread) and inner loop (ADC ISR).
+// The writer fills the buffer it owns, then publishes it by flipping the index 
+// with a single store. The ISR always runs to completion before the thread resumes,
+// so it never sees a partially written buffer.
+CTL_INNER_PARAMS_T ctl_inner_params[2];
+volatile uint32_t ctl_inner_idx=0; // buffer read by ISR
+CTL_OUTER_ACCUM_T ctl_outer_accum[2];
+volatile uint32_t ctl_accum_idx=0; // buffer written by ISR
+
+// Quantization errors from previous two PWM periods, for dithering
+static FX16_16 dither_e1=0, dither_e2=0;
+
+// Consecutive samples with fault conditions
+static int32_t fault_n_open=0, fault_n_diverge=0;
+// Samples since setpoint changed, up to FAULT_DIVERGE_SETTLE_SAMPLES (settled)
+static int32_t fault_n_settle=0, fault_prev_set=0;
+static int32_t fault_limit_set=0; // Setpoint the short ceiling is based on
+
 float UpdatePID(SPid * pid, float error, float position){
 	float pTerm, dTerm, iTerm;
 
@@ -115,11 +160,116 @@ FX16_16 UpdatePID_FX(SPidFX * pid, FX16_16 error_FX, FX16_16 position_FX){
 	return ret_val;
 }
 
+#if USE_PWM_DITHER
+/* Sigma-delta modulator: quantize duty_FX to an integer PWM value, feeding the 
+quantization error forward to the following PWM periods. */
+static __inline int32_t Dither_Duty(FX16_16 duty_FX) {
+	FX16_16 v;
+	int32_t out;
+#if PWM_DITHER_ORDER == 2
+	v = duty_FX - 2*dither_e1 + dither_e2; // NTF = (1-z^-1)^2
+	out = FX_TO_INT(v + INT_TO_FX(1)/2); // round
+	dither_e2 = dither_e1;
+	dither_e1 = INT_TO_FX(out) - v;
+#else
+	v = duty_FX - dither_e1; // NTF = (1-z^-1)
+	out = FX_TO_INT(v + INT_TO_FX(1)/2); // round
+	dither_e1 = INT_TO_FX(out) - v;
+#endif
+	if (out < 0)
+		out = 0;
+	else if (out > LIM_DUTY_CYCLE)
+		out = LIM_DUTY_CYCLE;
+	return out;
+}
+#endif
+
+/* Switch off converter immediately by handing pin from TPM0 to GPIO, which is 
+preset to hold the low-true switch off. */
+static __inline void Disconnect_PWM_HBLED(void) {
+	PORTE->PCR[PWM_HBLED_PIN] = (PORTE->PCR[PWM_HBLED_PIN] & ~PORT_PCR_MUX_MASK) | PORT_PCR_MUX(1);
+}
+
+static __inline void Reconnect_PWM_HBLED(void) {
+	PORTE->PCR[PWM_HBLED_PIN] = (PORTE->PCR[PWM_HBLED_PIN] & ~PORT_PCR_MUX_MASK) | PORT_PCR_MUX(3);
+}
+
+/* Check for LED faults while the converter runs, after the control law (if 
+enabled) has updated the duty cycle. Costs a few dozen cycles. */
+static __inline void Detect_Faults(void) {
+	int fault=0, err, in_band, regulating;
+
+	regulating = g_enable_control && (control_mode != OpenLoop);
+	if (g_set_current != fault_prev_set) { // Current may stay near the old setpoint for a while
+		if (g_set_current > fault_limit_set)
+			fault_limit_set = g_set_current;
+		fault_prev_set = g_set_current;
+		fault_n_settle = 0;
+		fault_n_diverge = 0;
+	}
+	err = g_set_current - g_measured_current;
+	in_band = (err <= FAULT_DIVERGE_MA) && (err >= -FAULT_DIVERGE_MA);
+	if (fault_n_settle < FAULT_DIVERGE_SETTLE_SAMPLES) {
+		if (in_band) // Reached setpoint
+			fault_n_settle = FAULT_DIVERGE_SETTLE_SAMPLES;
+		else
+			fault_n_settle++;
+		if (fault_n_settle >= FAULT_DIVERGE_SETTLE_SAMPLES)
+			fault_limit_set = g_set_current;
+	}
+
+	if (g_measured_current > (regulating? FAULT_OVERCURRENT_MA(fault_limit_set) : FAULT_OVERCURRENT_OPEN_LOOP_MA))
+		fault = FAULT_SHORT;
+	if (regulating) {
+		if ((g_duty_cycle >= LIM_DUTY_CYCLE) && (g_set_current >= MIN_THRESHOLD_SET)
+			&& (g_measured_current < (g_set_current>>1))) {
+			if (++fault_n_open >= FAULT_OPEN_SAMPLES)
+				fault |= FAULT_OPEN;
+		} else {
+			fault_n_open = 0;
+		}
+#if USE_FAULT_DIVERGE
+		if ((fault_n_settle >= FAULT_DIVERGE_SETTLE_SAMPLES) && !in_band) {
+			if (++fault_n_diverge >= FAULT_DIVERGE_SAMPLES)
+				fault |= FAULT_DIVERGE;
+		} else {
+			fault_n_diverge = 0;
+		}
+#endif
+	}
+	if (fault) {
+		Disconnect_PWM_HBLED();
+		pwm_cut |= PWM_CUT_FAULT;
+		g_led_fault |= fault;
+		g_duty_cycle_FX = 0;
+		g_duty_cycle = 0;
+		PWM_Set_Value(TPM0, PWM_HBLED_CHANNEL, 0);
+		fault_n_open = fault_n_diverge = 0;
+	}
+}
+
 void Control_HBLED(void) {
 	uint16_t res;
+	int err;
 	FX16_16 change_FX, error_FX;
+	CTL_INNER_PARAMS_T * p_params;
+	CTL_OUTER_ACCUM_T * p_accum;
 	FPTB->PSOR = MASK(DBG_CONTROLLER);
 	
+	// New PWM period: give pin back to TPM0 unless still over the limit or faulted
+	if (pwm_cut) {
+		__disable_irq(); // Don't let CMP0_IRQHandler trip between test and restore
+#if USE_HW_CURRENT_LIMIT
+		if (!(CMP0->SCR & CMP_SCR_COUT_MASK))
+			pwm_cut &= ~PWM_CUT_HW_LIMIT;
+#endif
+		if (!g_led_fault)
+			pwm_cut &= ~PWM_CUT_FAULT;
+		if (!pwm_cut)
+			Reconnect_PWM_HBLED();
+		__enable_irq();
+	}
+
 #if USE_ADC_INTERRUPT
 	// already completed conversion, so don't wait
 #else
@@ -130,74 +280,79 @@ void Control_HBLED(void) {
 
 	g_measured_current = (res*1500)>>16; // Extra Credit: Make this code work: V_REF_MV*MA_SCALING_FACTOR)/(ADC_FULL_SCALE*R_SENSE)
 
-	if (g_enable_control) {
+	if (g_enable_control && !g_led_fault) {
 		switch (control_mode) {
 			case OpenLoop:
 					// don't do anything!
+				g_duty_cycle_FX = INT_TO_FX(g_duty_cycle);
 				break;
 			case BangBang:
 				if (g_measured_current < g_set_current)
 					g_duty_cycle = LIM_DUTY_CYCLE;
 				else
 					g_duty_cycle = 0;
+				g_duty_cycle_FX = INT_TO_FX(g_duty_cycle);
 				break;
 			case Incremental:
 				if (g_measured_current < g_set_current)
-					g_duty_cycle += INC_STEP;
+					g_duty_cycle_FX += INC_STEP_FX;
 				else
-					g_duty_cycle -= INC_STEP;
+					g_duty_cycle_FX -= INC_STEP_FX;
 				break;
 			case Proportional:
 				g_duty_cycle += (pGain_8*(g_set_current - g_measured_current))/256; //  - 1;
+				g_duty_cycle_FX = INT_TO_FX(g_duty_cycle);
 			break;
 			case PID:
 				g_duty_cycle += UpdatePID(&plantPID, g_set_current - g_measured_current, g_measured_current);
+				g_duty_cycle_FX = INT_TO_FX(g_duty_cycle);
 				break;
 			case PID_FX:
 				error_FX = INT_TO_FX(g_set_current - g_measured_current);
 				change_FX = UpdatePID_FX(&plantPID_FX, error_FX, INT_TO_FX(g_measured_current));
-				g_duty_cycle += FX_TO_INT(change_FX);
+				g_duty_cycle_FX += change_FX; // keep fraction for dithering
+			break;
+			case PID_FX_Split: // Inner loop only. See Control_Outer_Update for the rest.
+				err = g_set_current - g_measured_current;
+				p_accum = &ctl_outer_accum[ctl_accum_idx];
+				p_accum->ErrorSum += err;
+				p_params = &ctl_inner_params[ctl_inner_idx];
+				g_duty_cycle_FX = p_params->DutyFF + p_params->PGain*err;
 			break;
 			default:
 				break;
 		}
 	
 		// Update PWM controller with duty cycle
-		if (g_duty_cycle < 0)
-			g_duty_cycle = 0;
-		else if (g_duty_cycle > LIM_DUTY_CYCLE)
-			g_duty_cycle = LIM_DUTY_CYCLE;
+		if (g_duty_cycle_FX < 0)
+			g_duty_cycle_FX = 0;
+		else if (g_duty_cycle_FX > INT_TO_FX(LIM_DUTY_CYCLE))
+			g_duty_cycle_FX = INT_TO_FX(LIM_DUTY_CYCLE);
+		g_duty_cycle = FX_TO_INT(g_duty_cycle_FX);
+#if USE_PWM_DITHER
+		PWM_Set_Value(TPM0, PWM_HBLED_CHANNEL, Dither_Duty(g_duty_cycle_FX));
+#else
 		PWM_Set_Value(TPM0, PWM_HBLED_CHANNEL, g_duty_cycle);
+#endif
+		Ctl_Timing_CnV_Written();
 	} // if g_enable_control
+	if (!g_led_fault) // PWM is running
+		Detect_Faults();
+#if USE_CONTROL_RECORDER
+	Rec_Control_Sample(res);
+#endif
+#if USE_FLASH_METRICS
+	Flash_Metrics_Sample(g_set_current, g_measured_current);
+#endif
+#if USE_ETS_CAPTURE
+	ETS_Sample(g_measured_current);
+#endif
+#if USE_STRIP_CHART
+	Strip_Sample(g_measured_current, g_set_current);
+#endif
 	
 	// Samples current and setpoint values of the HBLED to write to display once values have accumulated
-	
-	switch(state){
-		case INITALIZE:
-			for(int samples = 0; samples < 100; samples++){
-				g_measured_accum[samples] = 0;
-				g_set_accum[samples] = 0;
-				samples_taken = SAMPLE_OFFSET;
-			}
-			state = WAITING;
-			break;
-		
-		case WAITING:
-			if(g_set_current != 0)
-				state = SAMPLING;
-			break;
-		
-		case SAMPLING:
-			if(samples_taken < NUMBER_SAMPLES_NEEDED-1){
-			samples_taken++;
-			g_measured_accum[samples_taken] = g_measured_current;
-			g_set_accum[samples_taken] = g_set_current;
-			}
-			else
-				state = WAITING;
-			break;
-		
-	}
+	Capture_Sample(g_measured_current, g_set_current);
 
 	FPTB->PCOR = MASK(DBG_CONTROLLER);
 }
@@ -206,6 +361,7 @@ void Control_HBLED(void) {
 void ADC0_IRQHandler() {
 	osStatus_t result;
 	static int prev_conv_type = PRIORITY;
+	uint32_t t_entry = Ctl_Timing_ISR_Entry();
 	FPTB->PSOR = MASK(DBG_IRQ_ADC);
 	switch(prev_conv_type) {
 		case PRIORITY:
@@ -214,7 +370,13 @@ void ADC0_IRQHandler() {
 		case REQ_FROM_QUEUE:
 			queued_out.chan_num = queued_in.chan_num;
 			queued_out.result = ADC0->R[0];
-			result = osMessageQueuePut(q_post_ADC, &queued_out, NULL, 0);
+			result = osMessageQueuePut(q_post_ADC, &queued_out, 0, 0);
+		break;
+#if USE_ETS_CAPTURE
+		case ETS_EXTRA:
+			ETS_Extra_Sample(ADC0->R[0]);
+		break;
+#endif
 	}
 	time_remaining = check_timing();
 	
@@ -326,12 +488,30 @@ void ADC0_IRQHandler() {
 			NVIC_EnableIRQ(ADC0_IRQn);	
 		#endif // USE_ADC_INTERRUPT
 		#endif // USE_ADC_FOR_BUCK
+		#if USE_ETS_CAPTURE
+		// Equivalent-time sample between control samples, started by TPM0 compare
+		if ((prev_conv_type == PRIORITY) && ETS_Arm())
+			prev_conv_type = ETS_EXTRA;
+		else
+		#endif
 		prev_conv_type = PRIORITY;
 	}
+	Ctl_Timing_ISR_Exit(t_entry);
 	FPTB->PCOR = MASK(DBG_IRQ_ADC);
 }
 #endif
 
+#if USE_HW_CURRENT_LIMIT
+/* Comparator detected overcurrent. Runs at highest priority, so the switch is
+turned off within a microsecond, well inside the present PWM period. */
+void CMP0_IRQHandler(void) {
+	Disconnect_PWM_HBLED();
+	CMP0->SCR |= CMP_SCR_CFR_MASK;
+	pwm_cut |= PWM_CUT_HW_LIMIT;
+	g_hw_limit_trips++;
+}
+#endif
+
 uint16_t check_timing(void){
 	uint16_t x,y;
 	// uint16_t direction;
@@ -349,6 +529,12 @@ uint16_t check_timing(void){
 		return (TPM0->MOD - TPM0->CNT);	 // Must only go up to MOD
 	}
 }
+#if USE_HW_CURRENT_LIMIT && (HW_LIMIT_REF == HW_LIMIT_REF_DAC0)
+#define DAC_SETPOINT_MA(i) ((i) + HW_LIMIT_MARGIN_MA) // DAC0 is comparator threshold
+#else
+#define DAC_SETPOINT_MA(i) (i)
+#endif
+
 void Set_DAC(unsigned int code) {
 	// Force 16-bit write to DAC
 	uint16_t * dac0dat = (uint16_t *)&(DAC0->DAT[0].DATL);
@@ -380,6 +566,46 @@ void Init_DAC_HBLED(void) {
 	Set_DAC(0);
 }
 
+#if USE_HW_CURRENT_LIMIT
+void Init_CMP_HBLED(void) {
+	int code;
+
+	SIM->SCGC4 |= SIM_SCGC4_CMP_MASK;
+	SIM->SCGC5 |= SIM_SCGC5_PORTE_MASK;
+
+	// Select analog for comparator input pin
+	PORTE->PCR[HW_LIMIT_CMP_PIN] &= ~PORT_PCR_MUX_MASK;
+	PORTE->PCR[HW_LIMIT_CMP_PIN] |= PORT_PCR_MUX(0);
+
+	CMP0->CR0 = CMP_CR0_HYSTCTR(1) | CMP_CR0_FILTER_CNT(0); // 10 mV hysteresis, no filter
+	CMP0->CR1 = CMP_CR1_PMODE_MASK; // High speed mode
+
+#if HW_LIMIT_REF == HW_LIMIT_REF_DAC0
+	// DAC0 threshold is set by Update_Set_Current
+	CMP0->MUXCR = CMP_MUXCR_PSEL(HW_LIMIT_CMP_INPUT) | CMP_MUXCR_MSEL(HW_LIMIT_CMP_DAC0_INPUT);
+#else
+	code = MA_TO_CMP_DAC_CODE(HW_LIMIT_CURRENT_MA);
+	if (code < 0)
+		code = 0;
+	else if (code > 63)
+		code = 63;
+	// Enable 6-bit DAC with VDDA reference
+	CMP0->DACCR = CMP_DACCR_DACEN_MASK | CMP_DACCR_VRSEL_MASK | CMP_DACCR_VOSEL(code);
+	CMP0->MUXCR = CMP_MUXCR_PSEL(HW_LIMIT_CMP_INPUT) | CMP_MUXCR_MSEL(HW_LIMIT_CMP_DAC6B_INPUT);
+#endif
+
+	// Interrupt on rising output (current above threshold), clear stale flags
+	CMP0->SCR = CMP_SCR_IER_MASK | CMP_SCR_CFR_MASK | CMP_SCR_CFF_MASK;
+	
+	// Must be able to preempt ADC ISR
+	NVIC_SetPriority(CMP0_IRQn, 0); // 0, 64, 128 or 192
+	NVIC_ClearPendingIRQ(CMP0_IRQn); 
+	NVIC_EnableIRQ(CMP0_IRQn);	
+	
+	CMP0->CR1 |= CMP_CR1_EN_MASK;
+}
+#endif
+
 void Init_ADC_HBLED(void) {
 #if USE_ADC_FOR_BUCK
 	// Configure ADC to read Ch 8 (FPTB 0)
@@ -420,15 +646,101 @@ void Update_Set_Current(void) {
 		delay--;
 		if (delay == g_flash_duration) { // assumes runs every 1 ms
 			g_set_current = g_peak_set_current;
-			Set_DAC_mA(g_set_current);
+			Set_DAC_mA(DAC_SETPOINT_MA(g_set_current));
 		} else  if (delay == 0) {
 			delay = g_flash_period;
 			g_set_current = 0;
-			Set_DAC_mA(g_set_current);
+			Set_DAC_mA(DAC_SETPOINT_MA(g_set_current));
 		}
 	}
 }
 
+/* Outer (slow) loop for PID_FX_Split mode, called from Thread_Buck_Update_Setpoint. 
+Integrates the error gathered by the inner loop, selects the inner loop gain for 
+the present setpoint, and publishes new parameters to the ADC ISR. */
+void Control_Outer_Update(void) {
+	CTL_OUTER_ACCUM_T * p_accum;
+	CTL_INNER_PARAMS_T * p_params;
+	SOuterFX * pid = &plantOuter_FX;
+	uint32_t idx;
+	int band, set;
+	
+	if (control_mode != PID_FX_Split)
+		return;
+	
+	// Take the accumulator the ISR was filling, give it the other (cleared) one
+	idx = ctl_accum_idx;
+	ctl_accum_idx = idx ^ 1;
+	p_accum = &ctl_outer_accum[idx];
+	
+	set = g_set_current;
+	for (band = 0; band < CTL_NUM_GAIN_BANDS-1; band++) {
+		if (set <= Gain_Schedule[band].MaxCurrent)
+			break;
+	}
+
+	if (set > 0) { // Hold the integrator while the LED is off between flashes
+		pid->iDuty[band] += pid->iGain * p_accum->ErrorSum;
+		if (pid->iDuty[band] > pid->iMax)
+			pid->iDuty[band] = pid->iMax;
+		else if (pid->iDuty[band] < pid->iMin)
+			pid->iDuty[band] = pid->iMin;
+	}
+	p_accum->ErrorSum = 0;
+	
+	// Fill the parameter buffer the ISR isn't reading, then publish it
+	idx = ctl_inner_idx ^ 1;
+	p_params = &ctl_inner_params[idx];
+	if (set > 0)
+		p_params->DutyFF = pid->ffOffset + pid->ffGain*set + pid->iDuty[band];
+	else
+		p_params->DutyFF = 0;
+	p_params->PGain = Gain_Schedule[band].PGain;
+	ctl_inner_idx = idx;
+}
+
+/* Copy controller state, for recording. Call with the ADC ISR unable to run. */
+void Control_Save_State(CTL_STATE_T * s) {
+	s->Mode = control_mode;
+	s->Enable = g_enable_control;
+	s->SetCurrent = g_set_current;
+	s->LEDFault = g_led_fault;
+	s->DutyCycle = g_duty_cycle;
+	s->DutyCycle_FX = g_duty_cycle_FX;
+	s->PGain_8 = pGain_8;
+	s->PID = plantPID;
+	s->PID_FX = plantPID_FX;
+	s->Inner = ctl_inner_params[ctl_inner_idx];
+	s->Dither_E1 = dither_e1;
+	s->Dither_E2 = dither_e2;
+	s->Fault_N_Open = fault_n_open;
+	s->Fault_N_Diverge = fault_n_diverge;
+	s->Fault_N_Settle = fault_n_settle;
+	s->Fault_Prev_Set = fault_prev_set;
+	s->Fault_Limit_Set = fault_limit_set;
+}
+
+/* Restore controller state saved by Control_Save_State, for replay. */
+void Control_Load_State(const CTL_STATE_T * s) {
+	control_mode = (CTL_MODE_E) s->Mode;
+	g_enable_control = s->Enable;
+	g_set_current = s->SetCurrent;
+	g_led_fault = s->LEDFault;
+	g_duty_cycle = s->DutyCycle;
+	g_duty_cycle_FX = s->DutyCycle_FX;
+	pGain_8 = s->PGain_8;
+	plantPID = s->PID;
+	plantPID_FX = s->PID_FX;
+	ctl_inner_params[ctl_inner_idx] = s->Inner;
+	dither_e1 = s->Dither_E1;
+	dither_e2 = s->Dither_E2;
+	fault_n_open = s->Fault_N_Open;
+	fault_n_diverge = s->Fault_N_Diverge;
+	fault_n_settle = s->Fault_N_Settle;
+	fault_prev_set = s->Fault_Prev_Set;
+	fault_limit_set = s->Fault_Limit_Set;
+}
+
 void Init_Buck_HBLED(void) {
 	Init_DAC_HBLED();
 	Init_ADC_HBLED();
@@ -436,10 +748,16 @@ void Init_Buck_HBLED(void) {
 	// Configure driver for buck converter
 	// Set up PTE31 to use for SMPS with TPM0 Ch 4
 	SIM->SCGC5 |= SIM_SCGC5_PORTE_MASK;
-	PORTE->PCR[31]  &= PORT_PCR_MUX(7);
-	PORTE->PCR[31]  |= PORT_PCR_MUX(3);
+	PORTE->PCR[PWM_HBLED_PIN]  &= PORT_PCR_MUX(7);
+	PORTE->PCR[PWM_HBLED_PIN]  |= PORT_PCR_MUX(3);
+	// GPIO level used while disconnected. PWM is low-true, so high turns switch off.
+	PTE->PSOR = MASK(PWM_HBLED_PIN);
+	PTE->PDDR |= MASK(PWM_HBLED_PIN);
 	PWM_Init(TPM0, PWM_HBLED_CHANNEL, PWM_PERIOD, g_duty_cycle, 0, 0);
-	
+#if USE_HW_CURRENT_LIMIT
+	Init_CMP_HBLED();
+#endif
+
 }
 
 // Handler functions (callbacks)
@@ -473,7 +791,46 @@ void Control_DutyCycle_Handler(UI_FIELD_T * fld, int v) {
 			dc = 0;
 		else if (dc > LIM_DUTY_CYCLE)
 			dc = LIM_DUTY_CYCLE;
+		__disable_irq(); // Keep the write and its log entry between the same samples
 		*(fld->Val) = dc;
 		PWM_Set_Value(TPM0, PWM_HBLED_CHANNEL, g_duty_cycle);
+#if USE_CONTROL_RECORDER
+		Rec_Thread_Event(REC_EV_DUTY_CYCLE, 1, g_duty_cycle);
+#endif
+		__enable_irq();
+	}
+}
+
+/* Clear latched LED faults and the controller state built up before them. 
+Control resumes at the next sample. Also used by replay. */
+void Control_Fault_Clear(void) {
+	int i;
+	
+	// ISR doesn't touch controller state while faulted
+	plantPID.iState = 0;
+	plantPID.dState = 0;
+	plantPID_FX.iState = 0;
+	plantPID_FX.dState = 0;
+	// PID_FX_Split integrators, and the duty they gave the inner loop
+	for (i = 0; i < CTL_NUM_GAIN_BANDS; i++)
+		plantOuter_FX.iDuty[i] = 0;
+	for (i = 0; i < 2; i++) {
+		ctl_inner_params[i].DutyFF = 0;
+		ctl_outer_accum[i].ErrorSum = 0;
+	}
+	dither_e1 = dither_e2 = 0;
+	g_duty_cycle_FX = 0;
+	g_duty_cycle = 0;
+	g_led_fault = 0;
+}
+
+void Control_Fault_Clear_Handler(UI_FIELD_T * fld, int v) {
+	__disable_irq(); // Keep the clear and its log entry between the same samples
+	if (g_led_fault) {
+		Control_Fault_Clear();
+#if USE_CONTROL_RECORDER
+		Rec_Thread_Event(REC_EV_FAULT_CLEAR, 0, 0);
+#endif
 	}
+	__enable_irq();
 }
@@ -10,15 +10,11 @@
 #define UP (1)
 #define PRIORITY (1)
 #define REQ_FROM_QUEUE (2)
-#define NUMBER_SAMPLES_NEEDED (960)
+#define ETS_EXTRA (3)
 #define MIN_THRESHOLD_SET (5)
 #define CHECKER_SAMPLES (100)
 #define HIGH (1)
 #define LOW (1)
-#define INITALIZE (0)
-#define WAITING (1)
-#define SAMPLING (2)
-#define SAMPLE_OFFSET (100)
 
 // Flash parameters
 #define FLASH_PERIOD_MS (600)
@@ -28,11 +24,20 @@
 
 // Switching parameters
 #define PWM_HBLED_CHANNEL (4)
+#define PWM_HBLED_PIN (31) // PTE31, TPM0_CH4 is ALT3
 #define PWM_PERIOD (1000) 
 /* 48 MHz input clock. 
 	PWM frequency = 48 MHz/(PWM_PERIOD*2) 
 	Timer is in count-up/down mode. */
 #define LIM_DUTY_CYCLE (PWM_PERIOD-1)
+#define CTL_SAMPLE_FREQ_HZ (48000000/(2*PWM_PERIOD)) // Control_HBLED runs once per PWM period
+
+// Sigma-delta dithering of the duty cycle. The fractional part of the FX16_16
+// duty cycle is carried across PWM periods, so the average duty cycle has sub-LSB
+// resolution. This allows a smaller PWM_PERIOD (higher PWM frequency) without
+// losing current precision.
+#define USE_PWM_DITHER (1)
+#define PWM_DITHER_ORDER (1) // 1: first-order, 2: second-order noise shaping
 
 // Control approach configuration
 #define USE_ASYNC_SAMPLING 				0
@@ -68,12 +73,15 @@
 #endif
 
 // Control Parameters
-// default control mode: OpenLoop, BangBang, Incremental, PID, PID_FX
+// default control mode: OpenLoop, BangBang, Incremental, PID, PID_FX, PID_FX_Split
 // #define DEF_CONTROL_MODE (Incremental)
 #define DEF_CONTROL_MODE (PID_FX)
 
 // Incremental controller: change amount
 #define INC_STEP (PWM_PERIOD/100)
+// Finer steps need dithering to resolve them, and slow the rise in proportion
+#define INC_STEP_DIV (1) // e.g. 8 with USE_PWM_DITHER
+#define INC_STEP_FX (INT_TO_FX(INC_STEP)/INC_STEP_DIV)
 
 // Proportional Gain, scaled by 2^8
 #define PGAIN_8 (0x0028)
@@ -88,6 +96,19 @@
 #define I_GAIN_FX (40) 
 #define D_GAIN_FX (40000)
 
+// PID_FX_Split (multi-rate) gains. Guaranteed to be non-optimal.
+// Inner loop (ADC ISR, every PWM period): duty = DutyFF + PGain*error
+// Outer loop (Thread_Buck_Update_Setpoint, every THREAD_BUS_PERIOD_MS): 
+// integral of error, setpoint feedforward, and gain scheduling by setpoint
+// Feedforward is the steady-state duty of the plant: (LED_VF + I*R)/V_IN.
+#define PLANT_V_IN_MV (5000) // Converter supply
+#define PLANT_LED_VF_MV (2700) // LED threshold voltage
+#define PLANT_R_SERIES_MO (1500) // LED dynamic resistance, inductor and switch, besides R_SENSE
+#define I_GAIN_SPLIT_FX (FL_TO_FX(0.05)) // duty counts per mA*sample of error
+#define FF_GAIN_SPLIT_FX (FL_TO_FX((float) PWM_PERIOD*(PLANT_R_SERIES_MO + R_SENSE_MO)/(1000.0f*PLANT_V_IN_MV))) // duty counts per mA of setpoint
+#define FF_OFFSET_SPLIT_FX (INT_TO_FX(PWM_PERIOD*PLANT_LED_VF_MV/PLANT_V_IN_MV)) // duty counts
+#define CTL_NUM_GAIN_BANDS (3)
+
 // Data type definitions
 typedef struct {
 	float dState; // Last position input
@@ -107,17 +128,60 @@ typedef struct {
 				dGain; // derivative gain
 } SPidFX;
 
-typedef enum {OpenLoop, BangBang, Incremental, Proportional, PID, PID_FX} CTL_MODE_E;
+typedef struct {
+	int MaxCurrent; // Upper limit (mA) of setpoint band 
+	FX16_16 PGain; // Inner loop proportional gain for band, duty counts per mA
+} CTL_GAIN_BAND_T;
+
+typedef struct {
+	FX16_16 DutyFF; // Feedforward + integral duty from outer loop
+	FX16_16 PGain; // Scheduled proportional gain for inner loop
+} CTL_INNER_PARAMS_T;
+
+typedef struct {
+	int32_t ErrorSum; // Sum of inner loop errors (mA) since last outer loop update
+} CTL_OUTER_ACCUM_T;
+
+typedef struct {
+	FX16_16 iDuty[CTL_NUM_GAIN_BANDS]; // Integral state, kept per band so it adapts to each setpoint range
+	FX16_16 iMax, iMin; // Maximum and minimum allowable integrator state
+	FX16_16 iGain, // integral gain
+				ffGain, // feedforward gain
+				ffOffset; // feedforward offset
+} SOuterFX;
+
+typedef enum {OpenLoop, BangBang, Incremental, Proportional, PID, PID_FX, PID_FX_Split} CTL_MODE_E;
+
+// Everything Control_HBLED carries from one sample to the next. Saved at the 
+// start of a recording so it can be replayed exactly on the host. 
+// Only 32-bit members, so layout is the same for armcc and host compilers.
+typedef struct {
+	int32_t Mode, Enable, SetCurrent, LEDFault;
+	int32_t DutyCycle;
+	FX16_16 DutyCycle_FX;
+	int32_t PGain_8;
+	SPid PID;
+	SPidFX PID_FX;
+	CTL_INNER_PARAMS_T Inner;
+	FX16_16 Dither_E1, Dither_E2;
+	int32_t Fault_N_Open, Fault_N_Diverge, Fault_N_Settle, Fault_Prev_Set, Fault_Limit_Set;
+} CTL_STATE_T;
 
 // Functions
 void Init_Buck_HBLED(void);
 void Update_Set_Current(void);
+void Control_Outer_Update(void);
+void Control_HBLED(void);
+void Control_Save_State(CTL_STATE_T * s);
+void Control_Load_State(const CTL_STATE_T * s);
+void Control_Fault_Clear(void);
 uint16_t check_timing(void);
 
 // Handler functions (callbacks)
 void Control_OnOff_Handler (UI_FIELD_T * fld, int v);
 void Control_IntNonNegative_Handler (UI_FIELD_T * fld, int v);
 void Control_DutyCycle_Handler(UI_FIELD_T * fld, int v);
+void Control_Fault_Clear_Handler(UI_FIELD_T * fld, int v);
 
 // Shared global variables
 extern volatile int g_set_current; // Default starting LED current
@@ -127,14 +191,21 @@ extern volatile int g_flash_period;
 
 extern volatile int g_measured_current;
 extern volatile int32_t g_duty_cycle;  // global to give debugger access
+extern volatile FX16_16 g_duty_cycle_FX; // full-resolution duty cycle
 
 extern volatile int g_enable_control;
 extern volatile CTL_MODE_E control_mode;
 extern volatile int g_enable_flash;
 extern volatile int error;
+extern volatile int g_hw_limit_trips;
+extern volatile int g_led_fault;
 
+extern int32_t pGain_8;
 extern SPidFX plantPID_FX;
 extern SPid plantPID;
+extern SOuterFX plantOuter_FX;
+extern CTL_INNER_PARAMS_T ctl_inner_params[2];
+extern volatile uint32_t ctl_inner_idx;
 
 // Hardware configuration
 #define ADC_SENSE_CHANNEL (8)
@@ -156,6 +227,51 @@ extern SPid plantPID;
 #define DAC_RESOLUTION 4096
 
 #define MA_TO_DAC_CODE(i) ((i)*(2.2f*DAC_RESOLUTION/V_REF_MV))
+
+// LED fault detection, checked every control sample. Any fault latches into 
+// g_led_fault, switches off the converter, and stops control until cleared.
+#define FAULT_OPEN (1) // Duty cycle saturated with current well below setpoint
+#define FAULT_SHORT (2) // Current above ceiling
+#define FAULT_DIVERGE (4) // Current far from setpoint for too long
+
+// Short ceiling while regulating: setpoint plus FAULT_OVERCURRENT_PCT plus margin.
+// Until the current settles after a setpoint change, the higher of the old and
+// new setpoints is used. Without regulation (open loop or control disabled) the
+// ceiling is fixed.
+#define FAULT_OVERCURRENT_PCT (100) // Simulated overshoot reaches 85% (PID, 150 mA)...
+#define FAULT_OVERCURRENT_MARGIN_MA (50) // ...plus room for noise at low setpoints
+#define FAULT_OVERCURRENT_MA(set) ((set) + (set)*FAULT_OVERCURRENT_PCT/100 + FAULT_OVERCURRENT_MARGIN_MA)
+#define FAULT_OVERCURRENT_OPEN_LOOP_MA (200)
+#define FAULT_OPEN_SAMPLES (48) // at PWM rate
+// The setpoint is settled (and divergence checked) once the current first comes
+// within FAULT_DIVERGE_MA of a new setpoint, or FAULT_DIVERGE_SETTLE_MS after
+// the change if it never does.
+#define USE_FAULT_DIVERGE (1)
+#define FAULT_DIVERGE_MA (20)
+#define FAULT_DIVERGE_SAMPLES (96) // at PWM rate, once armed
+#define FAULT_DIVERGE_SETTLE_MS (FLASH_DURATION_MS/2) // Simulated ramps take under 1.5 ms
+#define FAULT_DIVERGE_SETTLE_SAMPLES (CTL_SAMPLE_FREQ_HZ*FAULT_DIVERGE_SETTLE_MS/1000)
+
+// Hardware cycle-by-cycle current limit. Sense node is compared by CMP0 against
+// a threshold. A rising comparator output cuts the PWM pin off within the same 
+// PWM period, and the pin is given back to TPM0 at the start of the next period.
+// Requires a jumper from the sense node (PTB0) to HW_LIMIT_CMP_PIN.
+#define USE_HW_CURRENT_LIMIT (0)
+
+#define HW_LIMIT_REF_DAC6B (0) // Fixed threshold from CMP0 internal 6-bit DAC
+#define HW_LIMIT_REF_DAC0 (1) // Threshold from DAC0, tracks setpoint plus margin
+#define HW_LIMIT_REF (HW_LIMIT_REF_DAC6B)
+
+#define HW_LIMIT_CURRENT_MA (150) // Fixed threshold for HW_LIMIT_REF_DAC6B
+#define HW_LIMIT_MARGIN_MA (30) // Margin above setpoint for HW_LIMIT_REF_DAC0
+
+#define HW_LIMIT_CMP_INPUT (5) // CMP0_IN5 is PTE29 (sound amp enable, unused here)
+#define HW_LIMIT_CMP_PIN (29) // on port E
+#define HW_LIMIT_CMP_DAC6B_INPUT (7) // CMP0_IN7 is 6-bit DAC
+#define HW_LIMIT_CMP_DAC0_INPUT (4) // CMP0_IN4 is DAC0 output
+
+// 6-bit DAC output is (VOSEL+1)*V_REF/64
+#define MA_TO_CMP_DAC_CODE(i) ((int)((i)*R_SENSE*64/V_REF_MV) - 1)
 // #define MA_TO_DAC_CODE(i) (i*2.2*DAC_RESOLUTION/V_REF_MV) // Introduces timing delay and interesting bug!
 
 #endif // #ifndef CONTROL_H
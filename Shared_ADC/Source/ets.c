@@ -0,0 +1,192 @@
+#include <MKL25Z4.H>
+#include <stdint.h>
+
+#include "control.h"
+#include "ets.h"
+
+#if USE_ETS_CAPTURE
+
+#define ETS_PERIOD_NS (2*PWM_PERIOD*1000/48) // TPM0 clocked at 48 MHz, up/down counting
+
+ETS_T g_ets = {ETS_MAGIC, ETS_PHASES, ETS_PERIODS, ETS_PRE_PERIODS, ETS_PERIOD_NS/ETS_PHASES};
+volatile int g_ets_enable=0;
+volatile int g_ets_phase=0;
+
+static volatile int ets_reset=0; // Set by thread to start over when enabled
+
+// Used by ISRs
+static volatile uint32_t ets_count; // PWM periods, counted by TPM0 overflow
+static volatile uint32_t ets_compare_n; // Period of last compare match
+static volatile int ets_armed; // ADC waiting for compare match to start extra conversion
+static volatile int ets_active; // Window in progress...
+static uint32_t ets_start; // ...starting at this period
+static int ets_dir; // Count direction of wanted compare match: 1 up, -1 down, 0 either
+static int ets_prev_set;
+static int16_t ets_hist[ETS_PRE_PERIODS][2]; // Phase 0 and phase g_ets_phase samples before edge
+
+/* Store a sample taken in PWM period n at phase 0 (slot 0) or g_ets_phase (slot 1). */
+static void ETS_Store(uint32_t n, int slot, int v) {
+	uint32_t j;
+
+	if (v > INT16_MAX)
+		v = INT16_MAX;
+	__disable_irq(); // Overflow ISR may start a window
+	if (ets_active) {
+		j = n - ets_start;
+		if (j < ETS_PERIODS)
+			g_ets.Wave[j*ETS_PHASES + (slot? g_ets_phase : 0)] = v;
+	} else {
+		ets_hist[n % ETS_PRE_PERIODS][slot] = v;
+	}
+	__enable_irq();
+}
+
+static void ETS_Clear_History(void) {
+	int i;
+
+	for (i=0; i<ETS_PRE_PERIODS; i++) {
+		ets_hist[i][0] = ETS_NO_SAMPLE;
+		ets_hist[i][1] = ETS_NO_SAMPLE;
+	}
+}
+
+/* Program the compare channel for phase k. The counter passes each compare value
+twice per period (up, then down), and the overflow is at count 0, so phase k/N
+is count 2*k*MOD/N on the way up for the first half period, and on the way down
+for the second. */
+static void ETS_Set_Phase(int k) {
+	g_ets_phase = k;
+	if (k == 0) { // Control loop's own sample, no extra conversion
+		TPM0->CONTROLS[ETS_TPM_CHANNEL].CnSC = TPM_CnSC_MSB_MASK;
+		return;
+	}
+	if (2*k < ETS_PHASES) {
+		TPM0->CONTROLS[ETS_TPM_CHANNEL].CnV = 2*k*PWM_PERIOD/ETS_PHASES;
+		ets_dir = 1;
+	} else if (2*k > ETS_PHASES) {
+		TPM0->CONTROLS[ETS_TPM_CHANNEL].CnV = 2*(ETS_PHASES-k)*PWM_PERIOD/ETS_PHASES;
+		ets_dir = -1;
+	} else {
+		TPM0->CONTROLS[ETS_TPM_CHANNEL].CnV = PWM_PERIOD;
+		ets_dir = 0;
+	}
+	// Pin not used, interrupt on match
+	TPM0->CONTROLS[ETS_TPM_CHANNEL].CnSC = TPM_CnSC_MSB_MASK | TPM_CnSC_CHIE_MASK | TPM_CnSC_CHF_MASK;
+}
+
+/* Called by TPM0_IRQHandler on overflow, i.e. at the start of each PWM period
+(when the control loop's conversion is triggered). Counts periods and tracks
+the window around flash edges. */
+void ETS_Overflow_IRQ(void) {
+	uint32_t n, m;
+	int set, edge;
+
+	n = ++ets_count;
+	set = g_set_current;
+	if (ets_reset) {
+		for (m=0; m<ETS_POINTS; m++)
+			g_ets.Wave[m] = ETS_NO_SAMPLE;
+		ETS_Clear_History();
+		ets_active = 0;
+		ets_prev_set = set;
+		ETS_Set_Phase(0);
+		ets_reset = 0;
+	}
+
+	edge = (set > 0) && (ets_prev_set <= 0);
+	ets_prev_set = set;
+	if (ets_active) {
+		if (n - ets_start >= ETS_PERIODS) { // Window complete
+			ETS_Clear_History();
+			ets_active = 0;
+			g_ets.Pulses++;
+			if (g_ets_phase == ETS_PHASES-1)
+				g_ets.Seq++;
+			ETS_Set_Phase((g_ets_phase+1) % ETS_PHASES);
+		}
+	} else if (edge) { // Start window with history
+		ets_start = n - ETS_PRE_PERIODS;
+		for (m = ets_start; m != n; m++) {
+			g_ets.Wave[(m - ets_start)*ETS_PHASES] = ets_hist[m % ETS_PRE_PERIODS][0];
+			if (g_ets_phase != 0)
+				g_ets.Wave[(m - ets_start)*ETS_PHASES + g_ets_phase] = ets_hist[m % ETS_PRE_PERIODS][1];
+		}
+		ets_active = 1;
+	}
+}
+
+/* Called by Control_HBLED with the control loop's sample (phase 0). */
+void ETS_Sample(int measured) {
+	if (g_ets_enable)
+		ETS_Store(ets_count, 0, measured);
+}
+
+/* Called by the ADC0 ISR after the control loop's conversion. Returns 1 if the
+extra conversion for this period is wanted and its compare match is still to
+come; the ADC is then left software triggered for ETS_Compare_IRQ to start it. */
+int ETS_Arm(void) {
+	int armed = 0;
+
+	if (!g_ets_enable || (g_ets_phase == 0))
+		return 0;
+	__disable_irq();
+	if (ets_compare_n != ets_count) {
+		ADC0->SC2 &= ~ADC_SC2_ADTRG_MASK;
+		ets_armed = armed = 1;
+	}
+	__enable_irq();
+	return armed;
+}
+
+/* Called by the ADC0 ISR with the result of the extra conversion. */
+void ETS_Extra_Sample(uint16_t res) {
+	if (g_ets_enable)
+		ETS_Store(ets_count, 1, (res*1500)>>16); // Same scaling as Control_HBLED
+}
+
+/* Called by TPM0_IRQHandler on compare match. Starts the extra conversion if
+the ADC0 ISR has armed it, otherwise the ADC was busy (touchscreen conversion,
+or control result not read yet) and the point is skipped. */
+void ETS_Compare_IRQ(void) {
+	uint32_t c1, c2;
+
+	c1 = TPM0->CNT;
+	c2 = TPM0->CNT;
+	if ((ets_dir > 0 && c2 < c1) || (ets_dir < 0 && c2 > c1) || (g_ets_phase == 0))
+		return; // Other match of this period
+
+	ets_compare_n = ets_count;
+	if (!ets_armed) {
+		g_ets.Missed++;
+		return;
+	}
+	ets_armed = 0;
+	ADC0->SC1[0] = ADC_SC1_AIEN(1) | ADC_SC1_ADCH(ADC_SENSE_CHANNEL);
+}
+
+/* Start over from phase 0 when turned on. */
+void ETS_Enable_Handler(UI_FIELD_T * fld, int v) {
+	if (v > 0) {
+		if (g_ets_enable)
+			return;
+		ets_reset = 1;
+		NVIC_SetPriority(TPM0_IRQn, 64); // Above ADC0 so periods are counted first and the extra conversion starts on time
+		NVIC_ClearPendingIRQ(TPM0_IRQn);
+		TPM0->SC |= TPM_SC_TOIE_MASK;
+		NVIC_EnableIRQ(TPM0_IRQn);
+		g_ets_enable = 1;
+	} else {
+		__disable_irq();
+		g_ets_enable = 0;
+		NVIC_DisableIRQ(TPM0_IRQn);
+		TPM0->SC &= ~TPM_SC_TOIE_MASK;
+		TPM0->CONTROLS[ETS_TPM_CHANNEL].CnSC = 0;
+		if (ets_armed) { // Finish the sequence the ADC0 ISR expects
+			ets_armed = 0;
+			ADC0->SC1[0] = ADC_SC1_AIEN(1) | ADC_SC1_ADCH(ADC_SENSE_CHANNEL);
+		}
+		__enable_irq();
+	}
+}
+
+#endif // USE_ETS_CAPTURE
@@ -0,0 +1,68 @@
+#ifndef ETS_H
+#define ETS_H
+
+#include <stdint.h>
+#include "control.h"
+#include "UI.h"
+
+/* Equivalent-time sampling of repetitive flash pulses. The control loop samples
+the current once per PWM period, which gives only a few points on a flash edge.
+Flashes repeat, so on each pulse one extra conversion per PWM period is made
+at a phase k/ETS_PHASES of the period after the control loop's sample, with k
+advancing by one each pulse. After ETS_PHASES pulses the samples are
+interleaved into one waveform with ETS_PHASES times the resolution.
+
+The extra conversion is part of the ADC0 ISR's sequence: after the control
+loop's sample, ETS_Arm switches the ADC to software triggering, and the TPM0
+compare interrupt (channel ETS_TPM_CHANNEL, no pin) starts the conversion at
+phase k. Its result goes to ETS_Extra_Sample, and the ADC0 ISR then restores
+hardware triggering for the next control sample. Touchscreen conversions take
+precedence; the point is then skipped (marked ETS_NO_SAMPLE) and counted in
+g_ets.Missed. Phase 0 is the control loop's own sample.
+
+PWM periods are counted by the TPM0 overflow interrupt, which also detects
+flash edges, so skipped control samples don't shift the waveform. The window
+starts ETS_PRE_PERIODS PWM periods before a flash edge (setpoint rising from
+zero) and lasts ETS_PERIODS periods. Point i of g_ets.Wave is
+i*g_ets.Sample_ns after the start of the window. Export it with the debugger, e.g.
+	SAVE ets.hex &g_ets, ((char *) &g_ets) + sizeof(g_ets)
+in uVision. */
+
+// Experimental, opt-in: adds ~1 KB RAM, which doesn't fit alongside the 
+// waterfall, and a TPM0 interrupt per PWM period while enabled. Its page is 
+// labelled "ETS (exp)". Needs the control loop's conversion to be hardware 
+// triggered by TPM0 overflow, and USE_LCD_TILES for its view.
+#define USE_ETS_CAPTURE (0)
+#if USE_ETS_CAPTURE && !USE_ADC_HW_TRIGGER
+#error "USE_ETS_CAPTURE needs USE_ADC_HW_TRIGGER"
+#endif
+
+#define ETS_PHASES (8) // Extra conversion must finish before the next TPM0 overflow
+#define ETS_PERIODS (30) // PWM periods in window
+#define ETS_PRE_PERIODS (4) // of which before flash edge
+#define ETS_POINTS (ETS_PHASES*ETS_PERIODS)
+#define ETS_TPM_CHANNEL (5)
+#define ETS_NO_SAMPLE (INT16_MIN)
+#define ETS_MAGIC (0x45545331) // "ETS1"
+
+typedef struct {
+	uint32_t Magic;
+	uint16_t Phases, Periods, PrePeriods, Sample_ns;
+	volatile uint32_t Seq; // Number of complete reconstructions (all phases filled)
+	volatile uint32_t Pulses; // Pulses sampled
+	volatile uint32_t Missed; // Extra conversions skipped because ADC was busy
+	int16_t Wave[ETS_POINTS]; // mA, index is period*ETS_PHASES + phase
+} ETS_T;
+
+extern ETS_T g_ets;
+extern volatile int g_ets_enable;
+extern volatile int g_ets_phase; // Phase used for current or next pulse
+
+void ETS_Sample(int measured);
+int ETS_Arm(void);
+void ETS_Extra_Sample(uint16_t res);
+void ETS_Overflow_IRQ(void);
+void ETS_Compare_IRQ(void);
+void ETS_Enable_Handler(UI_FIELD_T * fld, int v);
+
+#endif // ETS_H
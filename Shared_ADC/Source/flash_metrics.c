@@ -0,0 +1,134 @@
+#include <MKL25Z4.H>
+#include <stdint.h>
+#include <limits.h>
+
+#include "control.h"
+#include "FX.h"
+#include "flash_metrics.h"
+
+#if USE_FLASH_METRICS
+
+FLASH_METRICS_T g_fm_ring[FM_RING_SIZE];
+volatile uint32_t g_fm_count=0;
+FM_SUMMARY_T g_fm_summary;
+
+static struct { // Pulse in progress
+	int Set;
+	int32_t N; // samples since start
+	int32_t N10, N90, NLastOut; // sample numbers, -1 until reached
+	int Peak;
+	FX16_16 ErrAvg;
+	uint32_t ChargeSum; // mA*samples
+} fm;
+
+#define SAMPLES_TO_US(n) ((int)(((int64_t)(n)*1000000)/CTL_SAMPLE_FREQ_HZ))
+
+/* Runs once per pulse, so the divisions are affordable in the ISR. */
+static void Flash_Metrics_Finish(void) {
+	FLASH_METRICS_T * r = &g_fm_ring[g_fm_count % FM_RING_SIZE];
+	
+	r->Set = fm.Set;
+	r->Rise = ((fm.N10 >= 0) && (fm.N90 >= 0))? SAMPLES_TO_US(fm.N90 - fm.N10) : FM_NOT_SETTLED;
+	r->Overshoot = (fm.Peak > fm.Set)? ((fm.Peak - fm.Set)*100)/fm.Set : 0;
+	r->Settle = (fm.NLastOut < fm.N-1)? SAMPLES_TO_US(fm.NLastOut+1) : FM_NOT_SETTLED;
+	r->SSError = ((int64_t)fm.ErrAvg*1000) >> 16;
+	r->Charge = ((uint64_t)fm.ChargeSum*1000)/CTL_SAMPLE_FREQ_HZ;
+	g_fm_count++; // publish after record is complete
+}
+
+/* Called by Control_HBLED every sample. */
+void Flash_Metrics_Sample(int set, int measured) {
+	int err;
+	
+	if (set != fm.Set) { // Setpoint step ends previous pulse, may start new one
+		if ((fm.Set > 0) && (fm.N > 0))
+			Flash_Metrics_Finish();
+		fm.Set = set;
+		fm.N = 0;
+		fm.N10 = fm.N90 = fm.NLastOut = -1;
+		fm.Peak = 0;
+		fm.ErrAvg = INT_TO_FX(set);
+		fm.ChargeSum = 0;
+	}
+	if (set <= 0)
+		return;
+	
+	if ((fm.N10 < 0) && (measured*10 >= set))
+		fm.N10 = fm.N;
+	if ((fm.N90 < 0) && (measured*10 >= set*9))
+		fm.N90 = fm.N;
+	if (measured > fm.Peak)
+		fm.Peak = measured;
+	err = set - measured;
+	if (err < 0)
+		err = -err;
+	if ((err > FM_SETTLE_BAND_MIN_MA) && (err*100 > set*FM_SETTLE_BAND_PCT))
+		fm.NLastOut = fm.N;
+	fm.ErrAvg += (INT_TO_FX(set - measured) - fm.ErrAvg) >> FM_SS_SHIFT;
+	fm.ChargeSum += measured;
+	fm.N++;
+}
+
+static void FM_Stat_Init(FM_STAT_T * s) {
+	s->Min = INT_MAX;
+	s->Max = INT_MIN;
+	s->Mean = 0;
+}
+
+static void FM_Stat_Add(FM_STAT_T * s, int v) {
+	if (v < s->Min)
+		s->Min = v;
+	if (v > s->Max)
+		s->Max = v;
+	s->Mean += v; // sum until FM_Stat_Finish
+}
+
+static void FM_Stat_Finish(FM_STAT_T * s, int n) {
+	if (n > 0) {
+		s->Mean /= n;
+	} else {
+		s->Min = s->Max = s->Mean = 0;
+	}
+}
+
+/* Min, mean and max over pulses in ring. Called from a thread with a small
+stack, so records are copied one at a time, each with interrupts briefly off 
+so the ISR can't rewrite it halfway. */
+void Flash_Metrics_Update_Summary(void) {
+	FLASH_METRICS_T r;
+	uint32_t count;
+	int i, n, n_rise=0, n_settle=0;
+	FM_SUMMARY_T * s = &g_fm_summary;
+	
+	count = g_fm_count;
+	n = (count < FM_RING_SIZE)? count : FM_RING_SIZE;
+	FM_Stat_Init(&s->Rise);
+	FM_Stat_Init(&s->Overshoot);
+	FM_Stat_Init(&s->Settle);
+	FM_Stat_Init(&s->SSError);
+	FM_Stat_Init(&s->Charge);
+	for (i=0; i<n; i++) {
+		__disable_irq();
+		r = g_fm_ring[i];
+		__enable_irq();
+		if (r.Rise != FM_NOT_SETTLED) {
+			FM_Stat_Add(&s->Rise, r.Rise);
+			n_rise++;
+		}
+		if (r.Settle != FM_NOT_SETTLED) {
+			FM_Stat_Add(&s->Settle, r.Settle);
+			n_settle++;
+		}
+		FM_Stat_Add(&s->Overshoot, r.Overshoot);
+		FM_Stat_Add(&s->SSError, r.SSError);
+		FM_Stat_Add(&s->Charge, r.Charge);
+	}
+	FM_Stat_Finish(&s->Rise, n_rise);
+	FM_Stat_Finish(&s->Settle, n_settle);
+	FM_Stat_Finish(&s->Overshoot, n);
+	FM_Stat_Finish(&s->SSError, n);
+	FM_Stat_Finish(&s->Charge, n);
+	s->NumPulses = n;
+}
+
+#endif // USE_FLASH_METRICS
@@ -0,0 +1,45 @@
+#ifndef FLASH_METRICS_H
+#define FLASH_METRICS_H
+
+#include <stdint.h>
+
+/* Per-pulse flash quality metrics, computed incrementally in the control ISR
+with integer math. A pulse starts when the setpoint changes to a non-zero 
+value and ends when it changes again. Results of the latest FM_RING_SIZE 
+pulses are kept in a ring, and summarized for the UI by a thread. */
+
+#define USE_FLASH_METRICS (1)
+
+#define FM_RING_SIZE (8)
+#define FM_SETTLE_BAND_PCT (5) // Settled when within this band of setpoint...
+#define FM_SETTLE_BAND_MIN_MA (1) // ...but never narrower than this
+#define FM_NOT_SETTLED (-1)
+#define FM_SS_SHIFT (5) // Steady-state error is exponential average with time constant...
+#define FM_SS_SAMPLES (1<<FM_SS_SHIFT) // ...of this many samples
+
+typedef struct {
+	int Set; // mA
+	int Rise; // us from 10% to 90% of setpoint, or FM_NOT_SETTLED if 90% never reached
+	int Overshoot; // percent of setpoint
+	int Settle; // us from start of pulse until within band for rest of pulse, or FM_NOT_SETTLED
+	int SSError; // uA, setpoint - measured, averaged over about the last FM_SS_SAMPLES of pulse
+	int Charge; // mA*ms
+} FLASH_METRICS_T;
+
+typedef struct { 
+	int Min, Mean, Max;
+} FM_STAT_T;
+
+typedef struct { // Updated by Flash_Metrics_Update_Summary for UI
+	int NumPulses; // in ring
+	FM_STAT_T Rise, Overshoot, Settle, SSError, Charge; // Settle and Rise only over pulses which got there
+} FM_SUMMARY_T;
+
+extern FLASH_METRICS_T g_fm_ring[FM_RING_SIZE];
+extern volatile uint32_t g_fm_count; // Total pulses measured. Latest is g_fm_ring[(g_fm_count-1)%FM_RING_SIZE]
+extern FM_SUMMARY_T g_fm_summary;
+
+void Flash_Metrics_Sample(int set, int measured);
+void Flash_Metrics_Update_Summary(void);
+
+#endif // FLASH_METRICS_H
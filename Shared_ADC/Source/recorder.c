@@ -0,0 +1,146 @@
+#include <MKL25Z4.H>
+#include <stdint.h>
+#include <string.h>
+
+#include "control.h"
+#include "recorder.h"
+
+#if USE_CONTROL_RECORDER
+
+REC_LOG_T g_rec_log;
+volatile int g_rec_state=REC_IDLE;
+
+static CTL_STATE_T rec_state_before; // Snapshot after latest sample while armed
+static int rec_primed;
+static int32_t rec_set, rec_enable, rec_mode, rec_pgain_8;
+static uint32_t rec_inner_idx;
+static uint32_t rec_pid_gains[3], rec_pid_fx_gains[3]; // as written to log
+
+typedef union {
+	float F;
+	uint32_t W;
+} REC_FLOAT_T;
+
+static void Rec_PID_Gains(uint32_t * g, const SPid * pid) {
+	REC_FLOAT_T u;
+	
+	u.F = pid->pGain;
+	g[0] = u.W;
+	u.F = pid->iGain;
+	g[1] = u.W;
+	u.F = pid->dGain;
+	g[2] = u.W;
+}
+
+static int Rec_Put(uint32_t w) {
+	if (g_rec_log.Header.NumWords >= REC_LOG_WORDS)
+		return 0;
+	g_rec_log.Words[g_rec_log.Header.NumWords++] = w;
+	return 1;
+}
+
+/* Log changes made by threads since the previous sample. Returns 0 if log is full. */
+static int Rec_Put_Events(void) {
+	int ok = 1;
+	CTL_INNER_PARAMS_T * p;
+	uint32_t g[3];
+	
+	if (g_set_current != rec_set) {
+		rec_set = g_set_current;
+		ok = ok && Rec_Put(REC_EVENT(REC_EV_SET_CURRENT, 1)) && Rec_Put(rec_set);
+	}
+	if (g_enable_control != rec_enable) {
+		rec_enable = g_enable_control;
+		ok = ok && Rec_Put(REC_EVENT(REC_EV_ENABLE, 1)) && Rec_Put(rec_enable);
+	}
+	if (control_mode != rec_mode) {
+		rec_mode = control_mode;
+		ok = ok && Rec_Put(REC_EVENT(REC_EV_MODE, 1)) && Rec_Put(rec_mode);
+	}
+	if (ctl_inner_idx != rec_inner_idx) {
+		rec_inner_idx = ctl_inner_idx;
+		p = &ctl_inner_params[rec_inner_idx];
+		ok = ok && Rec_Put(REC_EVENT(REC_EV_INNER_PARAMS, 2)) && Rec_Put(p->DutyFF) && Rec_Put(p->PGain);
+	}
+	if (pGain_8 != rec_pgain_8) {
+		rec_pgain_8 = pGain_8;
+		ok = ok && Rec_Put(REC_EVENT(REC_EV_PGAIN_8, 1)) && Rec_Put(rec_pgain_8);
+	}
+	Rec_PID_Gains(g, &plantPID);
+	if ((g[0] != rec_pid_gains[0]) || (g[1] != rec_pid_gains[1]) || (g[2] != rec_pid_gains[2])) {
+		memcpy(rec_pid_gains, g, sizeof(g));
+		ok = ok && Rec_Put(REC_EVENT(REC_EV_PID_GAINS, 3)) && Rec_Put(g[0]) && Rec_Put(g[1]) && Rec_Put(g[2]);
+	}
+	if ((plantPID_FX.pGain != rec_pid_fx_gains[0]) || (plantPID_FX.iGain != rec_pid_fx_gains[1])
+		|| (plantPID_FX.dGain != rec_pid_fx_gains[2])) {
+		rec_pid_fx_gains[0] = plantPID_FX.pGain;
+		rec_pid_fx_gains[1] = plantPID_FX.iGain;
+		rec_pid_fx_gains[2] = plantPID_FX.dGain;
+		ok = ok && Rec_Put(REC_EVENT(REC_EV_PID_FX_GAINS, 3)) && Rec_Put(rec_pid_fx_gains[0])
+			&& Rec_Put(rec_pid_fx_gains[1]) && Rec_Put(rec_pid_fx_gains[2]);
+	}
+	return ok;
+}
+
+/* Called at end of Control_HBLED with the ADC result it used. */
+void Rec_Control_Sample(uint16_t res) {
+	switch (g_rec_state) {
+		case REC_ARMED:
+			if (rec_primed && (g_set_current != rec_state_before.SetCurrent)) {
+				g_rec_log.Header.State = rec_state_before;
+				rec_set = rec_state_before.SetCurrent;
+				rec_enable = rec_state_before.Enable;
+				rec_mode = rec_state_before.Mode;
+				rec_pgain_8 = rec_state_before.PGain_8;
+				Rec_PID_Gains(rec_pid_gains, &rec_state_before.PID);
+				rec_pid_fx_gains[0] = rec_state_before.PID_FX.pGain;
+				rec_pid_fx_gains[1] = rec_state_before.PID_FX.iGain;
+				rec_pid_fx_gains[2] = rec_state_before.PID_FX.dGain;
+				g_rec_state = REC_RECORDING;
+				// fall through to record this sample
+			} else {
+				Control_Save_State(&rec_state_before);
+				rec_inner_idx = ctl_inner_idx;
+				rec_primed = 1;
+				break;
+			}
+		case REC_RECORDING:
+			if (!Rec_Put_Events() || !Rec_Put(REC_SAMPLE(res, TPM0->CONTROLS[PWM_HBLED_CHANNEL].CnV)))
+				g_rec_state = REC_DONE;
+			break;
+		default:
+			break;
+	}
+}
+
+/* Log a parameter write made by a thread (len 0 or 1 payload words), so it lands
+between the samples it falls between. Call with interrupts disabled, in the 
+same critical section as the write. */
+void Rec_Thread_Event(REC_EVENT_E type, int len, int32_t v) {
+	if (g_rec_state == REC_ARMED)
+		rec_primed = 0; // Snapshot predates the write, so take another before starting
+	if (g_rec_state != REC_RECORDING)
+		return;
+	if (!Rec_Put(REC_EVENT(type, len)) || ((len > 0) && !Rec_Put(v)))
+		g_rec_state = REC_DONE;
+}
+
+/* Clear log and wait for next setpoint change. Called from a thread. */
+void Rec_Arm(void) {
+	g_rec_state = REC_IDLE; // ISR ignores log until armed
+	g_rec_log.Header.Magic = REC_MAGIC;
+	g_rec_log.Header.Version = REC_VERSION;
+	g_rec_log.Header.Config = REC_CONFIG;
+	g_rec_log.Header.NumWords = 0;
+	rec_primed = 0;
+	g_rec_state = REC_ARMED;
+}
+
+void Rec_Arm_Handler(UI_FIELD_T * fld, int v) {
+	if (v > 0)
+		Rec_Arm();
+	else
+		g_rec_state = REC_IDLE;
+}
+
+#endif // USE_CONTROL_RECORDER
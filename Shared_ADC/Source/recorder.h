@@ -0,0 +1,64 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <stdint.h>
+#include "control.h"
+
+/* Control loop recorder. Logs every ADC sample used by Control_HBLED and the 
+PWM compare value it produced, plus every write to a parameter it reads 
+(setpoint, enable, mode, inner loop parameters, gains, open loop duty cycle, 
+fault clear), starting with a snapshot of the controller state. 
+Recording starts at the first setpoint change after arming (e.g. a flash edge)
+and stops when the log is full. It continues through LED faults.
+
+The log (g_rec_log) is one block in RAM. Save it with the debugger, e.g.
+	SAVE rec.hex &g_rec_log, ((char *) &g_rec_log) + sizeof(g_rec_log)
+in uVision, then replay it with Host/build/ctl_replay. */
+
+#ifndef USE_CONTROL_RECORDER
+#define USE_CONTROL_RECORDER (0) // Log uses 4*REC_LOG_WORDS bytes of RAM
+#endif
+
+#define REC_LOG_WORDS (1024) // About 42 ms at 24 kHz
+#define REC_MAGIC (0x52434C31) // "RCL1"
+#define REC_VERSION (4)
+#define REC_CONFIG (PWM_PERIOD | (USE_PWM_DITHER<<16) | (PWM_DITHER_ORDER<<20))
+
+// Sample word: ADC result in bits 31-16, CnV in bits 14-0, bit 15 clear
+// Event word: bit 15 set, type in bits 14-8, count of payload words in bits 7-0.
+// Events precede the sample they apply to.
+#define REC_EVENT_FLAG (0x8000)
+#define REC_SAMPLE(adc, cnv) ((((uint32_t)(adc))<<16) | ((cnv) & 0x7fff))
+#define REC_EVENT(type, n) (REC_EVENT_FLAG | ((type)<<8) | (n))
+#define REC_IS_EVENT(w) ((w) & REC_EVENT_FLAG)
+#define REC_SAMPLE_ADC(w) ((uint16_t)((w)>>16))
+#define REC_SAMPLE_CNV(w) ((w) & 0x7fff)
+#define REC_EVENT_TYPE(w) (((w)>>8) & 0x7f)
+#define REC_EVENT_LEN(w) ((w) & 0xff)
+
+typedef enum {REC_EV_SET_CURRENT=1, REC_EV_ENABLE, REC_EV_MODE, REC_EV_INNER_PARAMS,
+	REC_EV_PGAIN_8, REC_EV_PID_GAINS, REC_EV_PID_FX_GAINS, // Gains changed (e.g. by debugger)
+	REC_EV_DUTY_CYCLE, REC_EV_FAULT_CLEAR} REC_EVENT_E; // Logged by UI handlers
+typedef enum {REC_IDLE, REC_ARMED, REC_RECORDING, REC_DONE} REC_STATE_E;
+
+typedef struct {
+	uint32_t Magic, Version;
+	uint32_t Config; // REC_CONFIG of recording firmware
+	uint32_t NumWords; // Valid words in log
+	CTL_STATE_T State; // Before first sample
+} REC_HEADER_T;
+
+typedef struct {
+	REC_HEADER_T Header;
+	uint32_t Words[REC_LOG_WORDS];
+} REC_LOG_T;
+
+extern REC_LOG_T g_rec_log;
+extern volatile int g_rec_state;
+
+void Rec_Arm(void);
+void Rec_Control_Sample(uint16_t res);
+void Rec_Thread_Event(REC_EVENT_E type, int len, int32_t v);
+void Rec_Arm_Handler(UI_FIELD_T * fld, int v);
+
+#endif // RECORDER_H
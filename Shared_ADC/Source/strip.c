@@ -0,0 +1,91 @@
+#include <stdint.h>
+
+#include "strip.h"
+
+#if USE_STRIP_CHART
+
+volatile int g_strip_enable = 0;
+volatile int g_strip_decimation = STRIP_DEF_DECIMATION;
+volatile int g_strip_overruns = 0;
+
+static CAPTURE_POINT_T strip_queue[STRIP_QUEUE_SIZE];
+static volatile uint32_t strip_head = 0; // Next point to write, only changed by ISR
+static volatile uint32_t strip_tail = 0; // Next point to read, only changed by thread
+
+// Used only by ISR
+static int strip_n = 0; // samples in point in progress...
+static int strip_dec; // ...of this many
+static int strip_min, strip_max, strip_sum, strip_sum_set;
+
+/* Called by Control_HBLED every sample. */
+void Strip_Sample(int measured, int set) {
+	CAPTURE_POINT_T * p;
+	uint32_t head;
+
+	if (!g_strip_enable) {
+		strip_n = 0;
+		return;
+	}
+	if (strip_n == 0) {
+		strip_dec = g_strip_decimation;
+		strip_min = strip_max = measured;
+		strip_sum = strip_sum_set = 0;
+	} else if (measured < strip_min) {
+		strip_min = measured;
+	} else if (measured > strip_max) {
+		strip_max = measured;
+	}
+	strip_sum += measured;
+	strip_sum_set += set;
+	if (++strip_n < strip_dec)
+		return;
+
+	strip_n = 0;
+	head = strip_head;
+	if (head - strip_tail >= STRIP_QUEUE_SIZE) {
+		g_strip_overruns++;
+		return;
+	}
+	p = &strip_queue[head & (STRIP_QUEUE_SIZE-1)];
+	p->Min = strip_min;
+	p->Max = strip_max;
+	p->Mean = (strip_sum*(1<<CAP_MEAN_FRAC_BITS) + strip_dec/2)/strip_dec;
+	p->Set = strip_sum_set/strip_dec;
+	strip_head = head + 1; // Publish point after writing it
+}
+
+/* Called by display thread. Copies the oldest queued point to p and returns 1,
+or returns 0 if the queue is empty. */
+int Strip_Get(CAPTURE_POINT_T * p) {
+	uint32_t tail = strip_tail;
+
+	if (tail == strip_head)
+		return 0;
+	*p = strip_queue[tail & (STRIP_QUEUE_SIZE-1)];
+	strip_tail = tail + 1;
+	return 1;
+}
+
+/* Enable flag and samples per line. Turning the chart on drops points queued
+before it was last turned off. */
+void Strip_Config_Handler(UI_FIELD_T * fld, int v) {
+	int n;
+
+	if (fld->Val == &g_strip_enable) {
+		if ((v > 0) && !g_strip_enable) {
+			strip_tail = strip_head; // ISR doesn't queue while disabled
+			g_strip_enable = 1;
+		} else if (v <= 0) {
+			g_strip_enable = 0;
+		}
+		return;
+	}
+	n = *fld->Val + v/16;
+	if (n < 1)
+		n = 1;
+	else if (n > STRIP_MAX_DECIMATION)
+		n = STRIP_MAX_DECIMATION;
+	*fld->Val = n;
+}
+
+#endif // USE_STRIP_CHART
@@ -0,0 +1,31 @@
+#ifndef STRIP_H
+#define STRIP_H
+
+#include <stdint.h>
+#include "UI.h"
+#include "capture.h"
+
+/* Rolling strip chart of measured and set current, shown as a waterfall (see 
+UI.c). While enabled, the control loop decimates samples into points of 
+g_strip_decimation samples, with the same statistics as capture points, and 
+queues them for the display thread. Unlike a capture there is no trigger: every
+point is shown, one line of pixels each.
+
+The queue has one writer (ISR) and one reader (display thread), each of which
+only advances its own index, so no locking is needed. If the display thread
+falls behind, new points are dropped and counted in g_strip_overruns. */
+
+#define USE_STRIP_CHART (1)
+#define STRIP_QUEUE_SIZE (16) // points, power of 2. 10 arrive per screen update at default rate
+#define STRIP_DEF_DECIMATION (240) // 10 ms per line
+#define STRIP_MAX_DECIMATION (24000) // Sum of samples (< 2^11 mA) with fraction bits fits int
+
+extern volatile int g_strip_enable;
+extern volatile int g_strip_decimation; // Samples per point, takes effect with next point
+extern volatile int g_strip_overruns;
+
+void Strip_Sample(int measured, int set);
+int Strip_Get(CAPTURE_POINT_T * p);
+void Strip_Config_Handler(UI_FIELD_T * fld, int v);
+
+#endif // STRIP_H
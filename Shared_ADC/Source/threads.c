@@ -72,6 +72,9 @@ void Thread_Read_TS(void * arg) {
 
  void Thread_Update_Screen(void * arg) {
 	
+#if USE_LCD_FILL_BENCHMARK
+	LCD_Fill_Benchmark();
+#endif
  UI_Draw_Screen(1);
 	 
 	while (1) {
@@ -86,6 +89,7 @@ void Thread_Read_TS(void * arg) {
 	while (1) {
 		osDelay(THREAD_BUS_PERIOD_MS);
 		Update_Set_Current();
+		Control_Outer_Update(); // Slow loop for PID_FX_Split, runs after setpoint changes
 	}
  }
  
\ No newline at end of file
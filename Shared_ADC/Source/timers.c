@@ -5,6 +5,7 @@
 #include "debug.h"
 // #include "HBLED.h"
 #include "control.h"
+#include "ets.h"
 
 volatile unsigned PIT_interrupt_counter = 0;
 volatile unsigned LCD_update_requested = 0;
@@ -69,6 +70,17 @@ void PWM_Set_Value(TPM_Type * TPM, uint8_t channel_num, uint16_t value) {
 }
 
 void TPM0_IRQHandler() {
+#if USE_ETS_CAPTURE
+	// Only equivalent-time sampling uses TPM0 interrupts in this configuration
+	if (TPM0->SC & TPM_SC_TOF_MASK) {
+		TPM0->SC |= TPM_SC_TOF_MASK;
+		ETS_Overflow_IRQ();
+	}
+	if (TPM0->CONTROLS[ETS_TPM_CHANNEL].CnSC & TPM_CnSC_CHF_MASK) {
+		TPM0->CONTROLS[ETS_TPM_CHANNEL].CnSC |= TPM_CnSC_CHF_MASK;
+		ETS_Compare_IRQ();
+	}
+#else
 	static uint32_t control_divider = SW_CTL_FREQ_DIV_FACTOR;
 	
 	FPTB->PSOR = MASK(DBG_IRQTPM);
@@ -89,6 +101,7 @@ void TPM0_IRQHandler() {
 	#endif
 	}
 	FPTB->PCOR = MASK(DBG_IRQTPM);
+#endif // USE_ETS_CAPTURE
 }
 void PIT_Init(unsigned period) {
 	// Enable clock to PIT module